@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Генератор справочника для бенчмарков в формате text.txt.
+
+    benchmarks/make_catalogue.py [--stops N] [--buses N] [--bus-length N]
+                                 [--requests N] [--seed N] > catalogue.json
+
+Остановки лежат на сетке вокруг Москвы, маршруты — случайные блуждания по соседним
+остановкам, дорожные расстояния заданы для каждой пары соседних остановок маршрута.
+Запросы смешаны как в text.txt: 60% Route, 20% Stop, 20% Bus, часть — на несуществующие имена.
+Значения по умолчанию дают файл около 5.3 МБ — для сравнения парсеров. Маршрутизатор
+предвычисляет все пары вершин, поэтому на таком справочнике он строится десятки секунд;
+для замеров запросов удобнее --stops 300 --buses 200.
+"""
+
+import argparse
+import json
+import math
+import random
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--stops', type=int, default=1000)
+    parser.add_argument('--buses', type=int, default=2000)
+    parser.add_argument('--bus-length', type=int, default=40)
+    parser.add_argument('--requests', type=int, default=20000)
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+
+    side = math.isqrt(args.stops - 1) + 1
+    names = ['Stop %d' % i for i in range(args.stops)]
+    distances = [dict() for _ in range(args.stops)]
+
+    def neighbours(i):
+        row, col = divmod(i, side)
+        for d_row, d_col in ((0, 1), (1, 0), (0, -1), (-1, 0)):
+            r, c = row + d_row, col + d_col
+            if 0 <= r < side and 0 <= c < side and r * side + c < args.stops:
+                yield r * side + c
+
+    buses = []
+    for number in range(args.buses):
+        stop = rng.randrange(args.stops)
+        route = [stop]
+        for _ in range(args.bus_length - 1):
+            stop = rng.choice(list(neighbours(stop)))
+            route.append(stop)
+        for a, b in zip(route, route[1:]):
+            if a != b and names[b] not in distances[a]:
+                distances[a][names[b]] = rng.randint(300, 3000)
+        is_roundtrip = rng.random() < 0.3
+        if is_roundtrip:
+            route.append(route[0])
+            if route[-2] != route[0]:
+                distances[route[-2]].setdefault(names[route[0]], rng.randint(300, 3000))
+        buses.append({
+            'type': 'Bus',
+            'name': 'Bus %d' % number,
+            'stops': [names[s] for s in route],
+            'is_roundtrip': is_roundtrip,
+        })
+
+    stops = []
+    for i, name in enumerate(names):
+        row, col = divmod(i, side)
+        stops.append({
+            'type': 'Stop',
+            'name': name,
+            'latitude': round(55.55 + 0.4 * row / side + rng.uniform(-1e-3, 1e-3), 6),
+            'longitude': round(37.35 + 0.55 * col / side + rng.uniform(-1e-3, 1e-3), 6),
+            'road_distances': distances[i],
+        })
+
+    def stop_name():
+        return names[rng.randrange(args.stops)] if rng.random() < 0.95 else 'Unknown stop'
+
+    requests = []
+    for request_id in range(1, args.requests + 1):
+        kind = rng.random()
+        if kind < 0.6:
+            requests.append({'id': request_id, 'type': 'Route', 'from': stop_name(), 'to': stop_name()})
+        elif kind < 0.8:
+            requests.append({'id': request_id, 'type': 'Stop', 'name': stop_name()})
+        else:
+            name = 'Bus %d' % rng.randrange(args.buses) if rng.random() < 0.95 else 'Unknown bus'
+            requests.append({'id': request_id, 'type': 'Bus', 'name': name})
+
+    json.dump({
+        'base_requests': stops + buses,
+        'render_settings': {
+            'width': 1200, 'height': 1200, 'padding': 50,
+            'stop_radius': 5, 'line_width': 14,
+            'bus_label_font_size': 20, 'bus_label_offset': [7, 15],
+            'stop_label_font_size': 20, 'stop_label_offset': [7, -3],
+            'underlayer_color': [255, 255, 255, 0.85], 'underlayer_width': 3,
+            'color_palette': ['green', [255, 160, 0], 'red'],
+        },
+        'routing_settings': {'bus_wait_time': 6, 'bus_velocity': 40},
+        'stat_requests': requests,
+    }, sys.stdout, ensure_ascii=False, indent=4)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Пропускная способность и задержки построчного режима --ndjson.
+
+    benchmarks/ndjson_bench.py ./transport_catalogue [text.txt] [--rates 1000,5000,20000,0]
+                               [--count 500]
+
+Справочник и запросы берутся из одного файла: процесс загружает его как базу, а stat_requests
+из него отправляются по одному в строке. Сначала весь поток запросов подаётся одним куском
+и замеряется время до последней строки ответа. Затем для каждой частоты из --rates запросы
+отправляются по одному с ожиданием ответа (0 — без пауз) и печатаются медиана и 99-й
+перцентиль задержки. Проверяется, что на каждую строку пришла ровно одна строка ответа.
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+import threading
+import time
+
+
+def send(process, data):
+    process.stdin.write(data)
+    process.stdin.flush()
+
+
+def start(app, base):
+    process = subprocess.Popen([app, '--ndjson', base], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                               stderr=subprocess.DEVNULL)
+    # Ответ на пробный запрос приходит после загрузки справочника, и она не попадает в замер
+    send(process, b'{"id": 0, "type": "Bus", "name": ""}\n')
+    process.stdout.readline()
+    return process
+
+
+def stop(process):
+    process.stdin.close()
+    rest = process.stdout.read()
+    process.wait()
+    return rest
+
+
+def run_piped(app, base, lines):
+    process = start(app, base)
+    started = time.perf_counter()
+    # Пишет отдельный поток: иначе при заполненных каналах запись и ответы ждут друг друга
+    writer = threading.Thread(target=send, args=(process, b''.join(lines)))
+    writer.start()
+    replies = [process.stdout.readline() for _ in lines]
+    elapsed = time.perf_counter() - started
+    writer.join()
+    extra = stop(process)
+    ok = all(reply.endswith(b'\n') for reply in replies) and not extra
+    print('piped: %d lines in %.1f ms (%.0f lines/s)%s'
+          % (len(lines), elapsed * 1e3, len(lines) / elapsed, '' if ok else ', REPLY MISMATCH'))
+    return ok
+
+
+def run_paced(app, base, lines, rate):
+    process = start(app, base)
+    latencies = []
+    started = time.perf_counter()
+    for i, line in enumerate(lines):
+        if rate:
+            target = started + i / rate
+            while time.perf_counter() < target:
+                pass
+        sent = time.perf_counter()
+        send(process, line)
+        process.stdout.readline()
+        latencies.append((time.perf_counter() - sent) * 1e6)
+    elapsed = time.perf_counter() - started
+    ok = not stop(process)
+    latencies.sort()
+    print('rate=%s: %d requests, %.0f/s, p50 %.0f us, p99 %.0f us%s'
+          % (rate or 'max', len(lines), len(lines) / elapsed, latencies[len(latencies) // 2],
+             latencies[int(len(latencies) * 0.99)], '' if ok else ', REPLY MISMATCH'))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('app')
+    parser.add_argument('base', nargs='?', default='text.txt')
+    parser.add_argument('--rates', default='1000,5000,20000,0')
+    parser.add_argument('--count', type=int, default=500)
+    args = parser.parse_args()
+
+    with open(args.base, encoding='utf-8') as base:
+        requests = json.load(base)['stat_requests']
+    lines = [(json.dumps(request, ensure_ascii=False) + '\n').encode() for request in requests]
+
+    ok = run_piped(args.app, args.base, lines)
+    for rate in (int(rate) for rate in args.rates.split(',')):
+        ok = run_paced(args.app, args.base, lines[:args.count], rate) and ok
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,82 @@
+// Загрузка и печать JSON-массива чисел: половина double, половина int.
+// Использует только json::Load(string_view) и json::Print, поэтому собирается
+// и с текущим json.cpp, и с версией до перехода на from_chars/to_chars (47f47fe^) — для сравнения:
+//
+//   cd transport-catalogue
+//   g++ -std=c++17 -O2 -pthread -I. -o number_bench benchmarks/number_bench.cpp json.cpp json_view.cpp json_index.cpp mapped_file.cpp thread_pool.cpp
+//   ./number_bench [pairs=200000] [repeats=10]
+//
+//   git worktree add /tmp/before 47f47fe^
+//   B=/tmp/before/transport-catalogue
+//   g++ -std=c++17 -O2 -I$B -o number_bench_before benchmarks/number_bench.cpp $B/json.cpp $B/mapped_file.cpp
+//
+// Печатает среднее время одного Load и одного Print. Напечатанный документ загружается обратно:
+// "equal" — числа совпали точно, "rounded" — печать округлила double (так было до from_chars/to_chars)
+
+#include "json.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ToMs(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+json::Document MakeNumbers(int count) {
+    json::Array numbers;
+    numbers.reserve(static_cast<size_t>(count) * 2);
+    for (int i = 0; i < count; ++i) {
+        // Координаты и расстояния из справочника выглядят примерно так
+        numbers.emplace_back(55.5 + i * 0.0001234567);
+        numbers.emplace_back(i * 37);
+    }
+    return json::Document{json::Node(std::move(numbers))};
+}
+
+std::string PrintToString(const json::Document& document) {
+    std::ostringstream out;
+    json::Print(document, out);
+    return out.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int count = argc > 1 ? std::stoi(argv[1]) : 200000;
+    const int repeats = argc > 2 ? std::stoi(argv[2]) : 10;
+
+    const json::Document numbers = MakeNumbers(count);
+    const std::string text = PrintToString(numbers);
+
+    size_t loaded = 0;
+    const auto load_start = Clock::now();
+    for (int i = 0; i < repeats; ++i) {
+        loaded += json::Load(std::string_view(text)).GetRoot().AsArray().size();
+    }
+    const auto load_end = Clock::now();
+
+    size_t printed = 0;
+    for (int i = 0; i < repeats; ++i) {
+        printed += PrintToString(numbers).size();
+    }
+    const auto print_end = Clock::now();
+
+    // Старая печать округляет double до 6 значащих цифр, поэтому сравнивается только число элементов
+    const json::Document reloaded = json::Load(std::string_view(text));
+    const bool same_size = reloaded.GetRoot().AsArray().size() == numbers.GetRoot().AsArray().size();
+
+    std::cout << "numbers: "sv << count * 2 << " ("sv << text.size() << " bytes), repeats: "sv << repeats << '\n'
+              << "load:  "sv << ToMs(load_end - load_start) / repeats << " ms\n"sv
+              << "print: "sv << ToMs(print_end - load_end) / repeats << " ms\n"sv
+              << "round trip: "sv << (reloaded == numbers ? "equal"sv : same_size ? "rounded"sv : "MISMATCH"sv) << '\n';
+    // Не даёт компилятору выбросить циклы
+    return loaded + printed == 0 ? 1 : (same_size ? 0 : 1);
+}
@@ -0,0 +1,110 @@
+// Сравнение парсеров RECURSIVE и STRUCTURAL_INDEX на файле: среднее время json::Load
+// из строки в памяти и json::LoadView без копирования строк, и проверка, что все
+// варианты строят равные документы.
+//
+//   cd transport-catalogue
+//   g++ -std=c++17 -O2 -pthread -I. -o parser_bench benchmarks/parser_bench.cpp json.cpp json_view.cpp json_index.cpp mapped_file.cpp thread_pool.cpp
+//   benchmarks/make_catalogue.py > /tmp/catalogue.json
+//   ./parser_bench text.txt /tmp/catalogue.json [--repeats=20] [--threads=N]
+//
+// Индекс строится с SSE2 на x86-64 или с AVX2 при сборке с -mavx2.
+// С --threads=N парсеры получают пул из N потоков, как main --threads=N
+
+#include "json.h"
+#include "json_view.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Can't open "s + path);
+    }
+    std::ostringstream buffer;
+    buffer << input.rdbuf();
+    return buffer.str();
+}
+
+template <typename LoadFunction>
+double MeasureMs(LoadFunction load, std::string_view text, json::ParserKind kind, ThreadPool* pool, int repeats) {
+    size_t keys = 0;
+    const auto start = Clock::now();
+    for (int i = 0; i < repeats; ++i) {
+        keys += load(text, kind, pool).GetRoot().AsMap().size();
+    }
+    const auto end = Clock::now();
+    if (keys == 0) {
+        std::cerr << "empty document"sv << std::endl;
+    }
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int repeats = 20;
+    size_t threads = 1;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.substr(0, 10) == "--repeats="sv) {
+            repeats = std::stoi(std::string(arg.substr(10)));
+        } else if (arg.substr(0, 10) == "--threads="sv) {
+            threads = std::stoul(std::string(arg.substr(10)));
+        } else {
+            paths.emplace_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "usage: "sv << argv[0] << " FILE... [--repeats=N] [--threads=N]"sv << std::endl;
+        return 2;
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+
+    bool all_equal = true;
+    for (const std::string& path : paths) {
+        const std::string text = ReadFile(path);
+        const json::Document expected = json::Load(text, json::ParserKind::RECURSIVE, pool.get());
+        const bool equal = expected == json::Load(text, json::ParserKind::STRUCTURAL_INDEX, pool.get())
+            && expected.GetRoot() == json::ToNode(json::LoadView(text, json::ParserKind::RECURSIVE, pool.get()).GetRoot())
+            && expected.GetRoot() == json::ToNode(json::LoadView(text, json::ParserKind::STRUCTURAL_INDEX, pool.get()).GetRoot());
+        all_equal = all_equal && equal;
+
+        const auto load = [](std::string_view input, json::ParserKind kind, ThreadPool* pool) {
+            return json::Load(input, kind, pool);
+        };
+        const auto load_view = [](std::string_view input, json::ParserKind kind, ThreadPool* pool) {
+            return json::LoadView(input, kind, pool);
+        };
+        const double recursive = MeasureMs(load, text, json::ParserKind::RECURSIVE, pool.get(), repeats);
+        const double indexed = MeasureMs(load, text, json::ParserKind::STRUCTURAL_INDEX, pool.get(), repeats);
+        const double recursive_view = MeasureMs(load_view, text, json::ParserKind::RECURSIVE, pool.get(), repeats);
+        const double indexed_view = MeasureMs(load_view, text, json::ParserKind::STRUCTURAL_INDEX, pool.get(), repeats);
+        std::cout << path << " ("sv << text.size() << " bytes, threads: "sv << threads << ")\n"sv
+                  << "  recursive:      "sv << recursive << " ms\n"sv
+                  << "  index:          "sv << indexed << " ms\n"sv
+                  << "  recursive view: "sv << recursive_view << " ms\n"sv
+                  << "  index view:     "sv << indexed_view << " ms\n"sv
+                  << "  documents: "sv << (equal ? "equal"sv : "DIFFERENT"sv) << '\n';
+    }
+    return all_equal ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// Пропускная способность ответов на stat_requests при разном числе потоков пула.
+// Справочник загружается и маршрутизатор строится один раз, до замеров; замеряется
+// только RequestManager::WriteResponses — ответы и их сериализация. Вывод при каждом
+// числе потоков сравнивается с последовательным (без пула) и должен совпасть байт в байт.
+//
+//   cd transport-catalogue
+//   g++ -std=c++17 -O2 -pthread -I. -o request_bench benchmarks/request_bench.cpp $(ls *.cpp | grep -v '^main.cpp$')
+//   benchmarks/make_catalogue.py --stops 300 --buses 200 --requests 20000 > /tmp/requests.json
+//   ./request_bench /tmp/requests.json [--max-threads=8] [--repeats=5]
+//
+// Потоки перебираются как 1, 2, 4, ... до --max-threads; 1 — последовательный путь без пула.
+// На одноядерной машине замер показывает только накладные расходы пула, а не ускорение
+
+#include "json_reader.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using namespace std::literals;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Run {
+    std::string output;
+    double ms = 0.0;
+};
+
+Run Answer(RequestManager& manager, const json::Node& stat_requests, ThreadPool* pool, int repeats) {
+    Run run;
+    Clock::duration total{};
+    for (int i = 0; i < repeats; ++i) {
+        manager.ParseStatRequests(stat_requests);
+        std::ostringstream out;
+        const auto start = Clock::now();
+        manager.WriteResponses(out, pool);
+        total += Clock::now() - start;
+        run.output = out.str();
+    }
+    run.ms = std::chrono::duration<double, std::milli>(total).count() / repeats;
+    return run;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = "text.txt";
+    size_t max_threads = 8;
+    int repeats = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.substr(0, 14) == "--max-threads="sv) {
+            max_threads = std::stoul(std::string(arg.substr(14)));
+        } else if (arg.substr(0, 10) == "--repeats="sv) {
+            repeats = std::stoi(std::string(arg.substr(10)));
+        } else {
+            path = arg;
+        }
+    }
+
+    const json::Document input = json::LoadFile(path);
+    const json::Dict& root = input.GetRoot().AsMap();
+    const json::Node& stat_requests = root.at("stat_requests"s);
+
+    TransportCatalogue catalogue;
+    RequestManager manager(catalogue);
+    manager.LoadBase(root);
+    manager.PrepareRouter();
+
+    const size_t count = stat_requests.AsArray().size();
+    std::cout << path << ": "sv << count << " requests, repeats: "sv << repeats << '\n';
+
+    const Run serial = Answer(manager, stat_requests, nullptr, repeats);
+    std::cout << "threads 1: "sv << serial.ms << " ms, "sv
+              << static_cast<size_t>(count / serial.ms * 1000.0) << " requests/s\n"sv;
+
+    bool identical = true;
+    for (size_t threads = 2; threads <= max_threads; threads *= 2) {
+        ThreadPool pool(threads);
+        const Run parallel = Answer(manager, stat_requests, &pool, repeats);
+        const bool same = parallel.output == serial.output;
+        identical = identical && same;
+        std::cout << "threads "sv << threads << ": "sv << parallel.ms << " ms, "sv
+                  << static_cast<size_t>(count / parallel.ms * 1000.0) << " requests/s"sv
+                  << (same ? ""sv : ", OUTPUT DIFFERS"sv) << '\n';
+    }
+    return identical ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -7,6 +8,8 @@ struct Stop {
     std::string name;
     double latitude;
     double longitude;
+    // Номер остановки в порядке добавления в справочник, от 0
+    size_t id = 0;
 };
 
 struct Bus {
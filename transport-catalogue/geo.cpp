@@ -1,6 +1,7 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace geo {
@@ -13,4 +14,47 @@ double ComputeDistance(Coordinates from, Coordinates to) {
         * EARTH_RADIUS;
 }
 
+void Box::Extend(Coordinates point) {
+    min_lat = std::min(min_lat, point.lat);
+    max_lat = std::max(max_lat, point.lat);
+    min_lng = std::min(min_lng, point.lng);
+    max_lng = std::max(max_lng, point.lng);
+}
+
+bool ClipSegment(const Box& box, Coordinates& from, Coordinates& to) {
+    const double d_lat = to.lat - from.lat;
+    const double d_lng = to.lng - from.lng;
+    double t_enter = 0.0;
+    double t_exit = 1.0;
+    // Для каждой из четырёх границ: p — проекция направления, q — расстояние до границы
+    const double p[] = {-d_lng, d_lng, -d_lat, d_lat};
+    const double q[] = {from.lng - box.min_lng, box.max_lng - from.lng,
+                        from.lat - box.min_lat, box.max_lat - from.lat};
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) {
+                return false;
+            }
+            continue;
+        }
+        const double t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            t_enter = std::max(t_enter, t);
+        } else {
+            t_exit = std::min(t_exit, t);
+        }
+        if (t_enter > t_exit) {
+            return false;
+        }
+    }
+    const Coordinates start = from;
+    if (t_enter > 0.0) {
+        from = {start.lat + t_enter * d_lat, start.lng + t_enter * d_lng};
+    }
+    if (t_exit < 1.0) {
+        to = {start.lat + t_exit * d_lat, start.lng + t_exit * d_lng};
+    }
+    return true;
+}
+
 }  // namespace geo
\ No newline at end of file
@@ -9,4 +9,27 @@ struct Coordinates {
 
 double ComputeDistance(Coordinates from, Coordinates to);
 
+// Прямоугольник в координатах широта/долгота, границы включаются
+struct Box {
+    double min_lat = 0;
+    double min_lng = 0;
+    double max_lat = 0;
+    double max_lng = 0;
+
+    bool Contains(Coordinates point) const {
+        return point.lat >= min_lat && point.lat <= max_lat
+            && point.lng >= min_lng && point.lng <= max_lng;
+    }
+    bool Intersects(const Box& other) const {
+        return other.min_lat <= max_lat && other.max_lat >= min_lat
+            && other.min_lng <= max_lng && other.max_lng >= min_lng;
+    }
+    // Расширяет прямоугольник так, чтобы он содержал point
+    void Extend(Coordinates point);
+};
+
+// Обрезает отрезок [from, to] по прямоугольнику box (алгоритм Лианга — Барски).
+// Возвращает false, если отрезок не пересекает box
+bool ClipSegment(const Box& box, Coordinates& from, Coordinates& to);
+
 }  // namespace geo
\ No newline at end of file
@@ -1,6 +1,16 @@
 #include "json.h"
+#include "json_view.h"
+#include "json_index.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
 
+#include <cctype>
+#include <charconv>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
 
 namespace json {
 
@@ -40,10 +50,7 @@ Node LoadDict(std::istream& input) {
         if (c == '"') {
             std::string key = LoadString(input).AsString();
             if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
-                }
-                dict.emplace(std::move(key), LoadNode(input));
+                dict.AppendUnordered(std::move(key), LoadNode(input));
             } else {
                 throw ParsingError(": is expected but '"s + c + "' has been found"s);
             }
@@ -54,6 +61,9 @@ Node LoadDict(std::istream& input) {
     if (!input) {
         throw ParsingError("Dictionary parsing error"s);
     }
+    if (const std::string* duplicate = dict.SortKeys()) {
+        throw ParsingError("Duplicate key '"s + *duplicate + "' have been found");
+    }
     return Node(std::move(dict));
 }
 
@@ -124,6 +134,26 @@ Node LoadNull(std::istream& input) {
     }
 }
 
+// Преобразует уже проверенную запись числа в int либо double.
+// std::from_chars не зависит от локали и не выделяет память.
+template <typename NodeType = Node>
+NodeType ConvertNumber(std::string_view parsed_num, bool is_int) {
+    const char* first = parsed_num.data();
+    const char* last = first + parsed_num.size();
+    if (is_int) {
+        int int_value;
+        // При переполнении int число будет прочитано как double
+        if (const auto [ptr, ec] = std::from_chars(first, last, int_value); ec == std::errc{} && ptr == last) {
+            return int_value;
+        }
+    }
+    double double_value;
+    if (const auto [ptr, ec] = std::from_chars(first, last, double_value); ec == std::errc{} && ptr == last) {
+        return double_value;
+    }
+    throw ParsingError("Failed to convert "s + std::string(parsed_num) + " to number"s);
+}
+
 Node LoadNumber(std::istream& input) {
     std::string parsed_num;
 
@@ -174,20 +204,7 @@ Node LoadNumber(std::istream& input) {
         is_int = false;
     }
 
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
-            }
-        }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
-    }
+    return ConvertNumber(parsed_num, is_int);
 }
 
 Node LoadNode(std::istream& input) {
@@ -222,6 +239,452 @@ Node LoadNode(std::istream& input) {
     }
 }
 
+// Типы, из которых BufferParser строит документ
+template <typename NodeType>
+struct Tree;
+
+template <>
+struct Tree<Node> {
+    using Array = json::Array;
+    using Dict = json::Dict;
+    using String = std::string;
+};
+
+template <>
+struct Tree<ViewNode> {
+    using Array = ViewArray;
+    using Dict = ViewDict;
+    using String = std::string_view;
+};
+
+// Парсер документа, целиком лежащего в памяти (например, в отображённом файле).
+// Принимает тот же язык и бросает те же ParsingError, что и потоковый LoadNode,
+// но читает символы напрямую из буфера, а строки без escape-последовательностей
+// создаёт одним куском, без посимвольного push_back. Для ViewNode такие строки
+// вовсе не копируются, а остальные после раскрытия escape-последовательностей
+// сохраняются в arena.
+// Если передан структурный индекс, пробелы и содержимое строк не просматриваются:
+// парсер переходит сразу к следующей позиции из индекса.
+// Если передан пул потоков, большие массивы верхнего уровня документа
+// (например, base_requests) разбираются на нём по частям.
+template <typename NodeType>
+class BufferParser {
+public:
+    using Array = typename Tree<NodeType>::Array;
+    using Dict = typename Tree<NodeType>::Dict;
+    using String = typename Tree<NodeType>::String;
+
+    explicit BufferParser(std::string_view input, const StructuralIndex* index = nullptr,
+                          ThreadPool* pool = nullptr, StringArena* arena = nullptr)
+        : begin_(input.data())
+        , pos_(input.data())
+        , end_(input.data() + input.size())
+        , index_(index)
+        , arena_(arena)
+        , pool_(pool) {
+    }
+
+    NodeType LoadNode() {
+        char c;
+        if (!NextToken(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c) {
+            case '[':
+                return LoadArray();
+            case '{':
+                return LoadDict();
+            case '"':
+                return NodeType(LoadString());
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                --pos_;
+                return LoadBool();
+            case 'n':
+                --pos_;
+                return LoadNull();
+            default:
+                --pos_;
+                return LoadNumber();
+        }
+    }
+
+private:
+    // Аналог input >> c: пропускает пробельные символы и читает следующий
+    bool NextToken(char& c) {
+        if (index_ != nullptr) {
+            // Между пробелом и следующей позицией индекса — только пробелы
+            if (pos_ != end_ && std::isspace(static_cast<unsigned char>(*pos_))) {
+                pos_ = NextIndexed();
+            }
+        } else {
+            while (pos_ != end_ && std::isspace(static_cast<unsigned char>(*pos_))) {
+                ++pos_;
+            }
+        }
+        if (pos_ == end_) {
+            return false;
+        }
+        c = *pos_++;
+        return true;
+    }
+
+    // Первая позиция индекса, не меньшая pos_, либо end_
+    const char* NextIndexed() {
+        const auto offset = static_cast<uint32_t>(pos_ - begin_);
+        while (cursor_ < index_->size() && (*index_)[cursor_] < offset) {
+            ++cursor_;
+        }
+        return cursor_ < index_->size() ? std::min(begin_ + (*index_)[cursor_], end_) : end_;
+    }
+
+    int Peek() const {
+        return pos_ != end_ ? static_cast<unsigned char>(*pos_) : std::char_traits<char>::eof();
+    }
+
+    std::string_view LoadLiteral() {
+        const char* begin = pos_;
+        while (pos_ != end_ && std::isalpha(static_cast<unsigned char>(*pos_))) {
+            ++pos_;
+        }
+        return {begin, static_cast<size_t>(pos_ - begin)};
+    }
+
+    NodeType LoadArray() {
+        if (pool_ != nullptr && depth_ == 1) {
+            if (auto result = TryLoadArrayParallel()) {
+                return NodeType(std::move(*result));
+            }
+        }
+        ++depth_;
+        Array result;
+        char c;
+        bool closed = false;
+        while (NextToken(c)) {
+            if (c == ']') {
+                closed = true;
+                break;
+            }
+            if (c != ',') {
+                --pos_;
+            }
+            result.push_back(LoadNode());
+        }
+        if (!closed) {
+            throw ParsingError("Array parsing error"s);
+        }
+        --depth_;
+        return NodeType(std::move(result));
+    }
+
+    // Разбирает фрагмент [pos, end) документа, содержащий элементы массива через запятую
+    BufferParser(const char* begin, const char* pos, const char* end, const StructuralIndex* index,
+                 StringArena* arena)
+        : begin_(begin)
+        , pos_(pos)
+        , end_(end)
+        , index_(index)
+        , arena_(arena) {
+        if (index_ != nullptr) {
+            const auto offset = static_cast<uint32_t>(pos_ - begin_);
+            cursor_ = std::lower_bound(index_->begin(), index_->end(), offset) - index_->begin();
+        }
+    }
+
+    Array LoadElements() {
+        Array result;
+        char c;
+        while (true) {
+            result.push_back(LoadNode());
+            if (!NextToken(c)) {
+                return result;
+            }
+            if (c != ',') {
+                throw ParsingError("',' is expected"s);
+            }
+        }
+    }
+
+    // Находит запятые, разделяющие элементы массива, и закрывающую скобку.
+    // Возвращает false, если массив не закрыт
+    bool ScanArray(std::vector<const char*>& commas, const char*& close) const {
+        int depth = 0;
+        for (const char* it = pos_; it != end_; ++it) {
+            switch (*it) {
+                case '"':
+                    for (++it; it != end_ && *it != '"'; ++it) {
+                        if (*it == '\\' && ++it == end_) {
+                            return false;
+                        }
+                    }
+                    if (it == end_) {
+                        return false;
+                    }
+                    break;
+                case '[':
+                    [[fallthrough]];
+                case '{':
+                    ++depth;
+                    break;
+                case ']':
+                    if (depth == 0) {
+                        close = it;
+                        return true;
+                    }
+                    [[fallthrough]];
+                case '}':
+                    --depth;
+                    break;
+                case ',':
+                    if (depth == 0) {
+                        commas.push_back(it);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return false;
+    }
+
+    // Параллельный разбор массива: элементы делятся на куски примерно равного
+    // размера по найденным запятым, куски разбираются в пуле и склеиваются по порядку.
+    // Если что-то пошло не так, возвращает nullopt, и массив разбирается
+    // последовательно — с той же ошибкой, что и без пула
+    std::optional<Array> TryLoadArrayParallel() {
+        static constexpr size_t MIN_PARALLEL_SIZE = 1 << 16;
+        static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+        std::vector<const char*> commas;
+        const char* close = nullptr;
+        if (!ScanArray(commas, close) || static_cast<size_t>(close - pos_) < MIN_PARALLEL_SIZE || commas.empty()) {
+            return std::nullopt;
+        }
+
+        const size_t chunk_count = std::min(pool_->Size() * CHUNKS_PER_THREAD, commas.size() + 1);
+        const size_t chunk_size = static_cast<size_t>(close - pos_) / chunk_count + 1;
+        // Задачи читают буфер и индекс, которыми владеет вызывающий, поэтому
+        // при любой ошибке сначала дожидаемся всех и только потом выходим
+        std::vector<std::future<Array>> chunks;
+        try {
+            const char* chunk_begin = pos_;
+            auto comma = commas.begin();
+            while (chunk_begin != nullptr) {
+                const char* target = chunk_begin + chunk_size;
+                comma = std::lower_bound(comma, commas.end(), target);
+                const char* chunk_end = comma != commas.end() ? *comma : close;
+                chunks.push_back(pool_->Submit([this, chunk_begin, chunk_end] {
+                    return BufferParser(begin_, chunk_begin, chunk_end, index_, arena_).LoadElements();
+                }));
+                chunk_begin = comma != commas.end() ? *comma++ + 1 : nullptr;
+            }
+        } catch (...) {
+            WaitAll(chunks);
+            throw;
+        }
+        WaitAll(chunks);
+
+        // Ошибка разбора куска ведёт к последовательному разбору, остальные передаются дальше
+        std::vector<Array> parts;
+        parts.reserve(chunks.size());
+        bool failed = false;
+        for (auto& chunk : chunks) {
+            try {
+                parts.push_back(chunk.get());
+            } catch (const ParsingError&) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            return std::nullopt;
+        }
+
+        Array result;
+        result.reserve(commas.size() + 1);
+        for (auto& part : parts) {
+            std::move(part.begin(), part.end(), std::back_inserter(result));
+        }
+        pos_ = close + 1;
+        return result;
+    }
+
+    NodeType LoadDict() {
+        ++depth_;
+        Dict dict;
+        char c;
+        bool closed = false;
+        while (NextToken(c)) {
+            if (c == '}') {
+                closed = true;
+                break;
+            }
+            if (c == '"') {
+                String key = LoadString();
+                if (NextToken(c) && c == ':') {
+                    dict.AppendUnordered(std::move(key), LoadNode());
+                } else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!closed) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+        if (const String* duplicate = dict.SortKeys()) {
+            throw ParsingError("Duplicate key '"s + std::string(*duplicate) + "' have been found");
+        }
+        --depth_;
+        return NodeType(std::move(dict));
+    }
+
+    String LoadString() {
+        // Быстрый путь: строка без escape-последовательностей берётся целиком
+        const char* begin = pos_;
+        const char* it = begin;
+        if (index_ != nullptr) {
+            // Ближайшая позиция индекса — закрывающая кавычка, слэш или перевод строки
+            it = NextIndexed();
+        } else {
+            while (it != end_ && *it != '"' && *it != '\\' && *it != '\n' && *it != '\r') {
+                ++it;
+            }
+        }
+        if (it != end_ && *it == '"') {
+            pos_ = it + 1;
+            return String(begin, static_cast<size_t>(it - begin));
+        }
+
+        std::string s(begin, it);
+        pos_ = it;
+        while (true) {
+            if (pos_ == end_) {
+                throw ParsingError("String parsing error");
+            }
+            const char ch = *pos_;
+            if (ch == '"') {
+                ++pos_;
+                break;
+            } else if (ch == '\\') {
+                ++pos_;
+                if (pos_ == end_) {
+                    throw ParsingError("String parsing error");
+                }
+                const char escaped_char = *pos_;
+                switch (escaped_char) {
+                    case 'n':
+                        s.push_back('\n');
+                        break;
+                    case 't':
+                        s.push_back('\t');
+                        break;
+                    case 'r':
+                        s.push_back('\r');
+                        break;
+                    case '"':
+                        s.push_back('"');
+                        break;
+                    case '\\':
+                        s.push_back('\\');
+                        break;
+                    default:
+                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                }
+            } else if (ch == '\n' || ch == '\r') {
+                throw ParsingError("Unexpected end of line"s);
+            } else {
+                s.push_back(ch);
+            }
+            ++pos_;
+        }
+        if constexpr (std::is_same_v<String, std::string>) {
+            return s;
+        } else {
+            return arena_->Store(std::move(s));
+        }
+    }
+
+    NodeType LoadBool() {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            return NodeType{true};
+        } else if (s == "false"sv) {
+            return NodeType{false};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
+    }
+
+    NodeType LoadNull() {
+        if (auto literal = LoadLiteral(); literal == "null"sv) {
+            return NodeType{nullptr};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
+    }
+
+    NodeType LoadNumber() {
+        const char* begin = pos_;
+
+        auto read_digits = [this] {
+            if (!std::isdigit(Peek())) {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (std::isdigit(Peek())) {
+                ++pos_;
+            }
+        };
+
+        if (Peek() == '-') {
+            ++pos_;
+        }
+        if (Peek() == '0') {
+            ++pos_;
+        } else {
+            read_digits();
+        }
+
+        bool is_int = true;
+        if (Peek() == '.') {
+            ++pos_;
+            read_digits();
+            is_int = false;
+        }
+
+        if (int ch = Peek(); ch == 'e' || ch == 'E') {
+            ++pos_;
+            if (ch = Peek(); ch == '+' || ch == '-') {
+                ++pos_;
+            }
+            read_digits();
+            is_int = false;
+        }
+
+        return ConvertNumber<NodeType>({begin, static_cast<size_t>(pos_ - begin)}, is_int);
+    }
+
+    const char* begin_;
+    const char* pos_;
+    const char* end_;
+    const StructuralIndex* index_;
+    // Только для ViewNode: сюда попадают строки с escape-последовательностями
+    StringArena* arena_ = nullptr;
+    size_t cursor_ = 0;
+    ThreadPool* pool_ = nullptr;
+    int depth_ = 0;
+};
+
+template <typename NodeType>
+NodeType LoadBuffer(std::string_view input, ParserKind kind, ThreadPool* pool, StringArena* arena = nullptr) {
+    if (kind == ParserKind::STRUCTURAL_INDEX && input.size() <= std::numeric_limits<uint32_t>::max()) {
+        const StructuralIndex index = BuildStructuralIndex(input);
+        return BufferParser<NodeType>(input, &index, pool, arena).LoadNode();
+    }
+    return BufferParser<NodeType>(input, nullptr, pool, arena).LoadNode();
+}
+
 struct PrintContext {
     std::ostream& out;
     int indent_step = 4;
@@ -272,6 +735,25 @@ void PrintString(const std::string& value, std::ostream& out) {
     out.put('"');
 }
 
+// Числа печатаются через std::to_chars: без локали и в кратчайшей записи,
+// которая читается обратно в то же самое значение
+template <typename Number>
+void PrintNumber(Number value, std::ostream& out) {
+    char buffer[32];
+    const auto [ptr, ec] = std::to_chars(std::begin(buffer), std::end(buffer), value);
+    out.write(buffer, ptr - buffer);
+}
+
+template <>
+void PrintValue<int>(const int& value, const PrintContext& ctx) {
+    PrintNumber(value, ctx.out);
+}
+
+template <>
+void PrintValue<double>(const double& value, const PrintContext& ctx) {
+    PrintNumber(value, ctx.out);
+}
+
 template <>
 void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
     PrintString(value, ctx.out);
@@ -347,6 +829,28 @@ Document Load(std::istream& input) {
     return Document{LoadNode(input)};
 }
 
+Document Load(std::string_view input, ParserKind kind, ThreadPool* pool) {
+    return Document{LoadBuffer<Node>(input, kind, pool)};
+}
+
+Document LoadFile(const std::string& path, ParserKind kind, ThreadPool* pool) {
+    const MappedFile file(path);
+    return Load(file.View(), kind, pool);
+}
+
+ViewDocument LoadView(std::string_view input, ParserKind kind, ThreadPool* pool) {
+    auto strings = std::make_unique<StringArena>();
+    ViewNode root = LoadBuffer<ViewNode>(input, kind, pool, strings.get());
+    return ViewDocument(nullptr, std::move(strings), std::move(root));
+}
+
+ViewDocument LoadFileView(const std::string& path, ParserKind kind, ThreadPool* pool) {
+    auto file = std::make_unique<MappedFile>(path);
+    auto strings = std::make_unique<StringArena>();
+    ViewNode root = LoadBuffer<ViewNode>(file->View(), kind, pool, strings.get());
+    return ViewDocument(std::move(file), std::move(strings), std::move(root));
+}
+
 void Print(const Document& doc, std::ostream& output) {
     PrintNode(doc.GetRoot(), PrintContext{output});
 }
@@ -1,22 +1,90 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
-#include <map>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
+class ThreadPool;
+
 namespace json {
 
 class Node;
-using Dict = std::map<std::string, Node>;
 using Array = std::vector<Node>;
 
+// Словарь JSON, хранящий пары ключ-значение в отсортированном по ключу векторе.
+// По сравнению с std::map не выделяет отдельный узел на каждый ключ, лучше
+// ложится в кэш и вдвое компактнее в составе Node. Интерфейс повторяет
+// используемое подмножество std::map, порядок обхода — по возрастанию ключа.
+// Key — std::string у Node и std::string_view у ViewNode (json_view.h)
+template <typename Key, typename Value>
+class BasicDict {
+public:
+    using value_type = std::pair<Key, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    iterator begin() {
+        return items_.begin();
+    }
+    iterator end() {
+        return items_.end();
+    }
+    const_iterator begin() const {
+        return items_.begin();
+    }
+    const_iterator end() const {
+        return items_.end();
+    }
+    size_t size() const {
+        return items_.size();
+    }
+    bool empty() const {
+        return items_.empty();
+    }
+    void reserve(size_t size) {
+        items_.reserve(size);
+    }
+
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    size_t count(std::string_view key) const;
+    const Value& at(std::string_view key) const;
+
+    // Как и std::map::emplace, не заменяет уже существующее значение
+    template <typename K, typename V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value);
+
+    // Для разбора: пары добавляются в порядке входа без поиска, а SortKeys
+    // упорядочивает их один раз, когда словарь закрыт. Так словарь из n ключей
+    // в произвольном порядке строится за O(n log n), а не за O(n^2), как через emplace
+    void AppendUnordered(Key key, Value value);
+    // Возвращает повторившийся ключ или nullptr. При повторе порядок пар не определён
+    const Key* SortKeys();
+
+    bool operator==(const BasicDict& rhs) const;
+
+private:
+    iterator LowerBound(std::string_view key);
+    const_iterator LowerBound(std::string_view key) const;
+
+    std::vector<value_type> items_;
+};
+
+using Dict = BasicDict<std::string, Node>;
+
 class ParsingError : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
 };
 
+// Узел владеет своими строками. Для разового чтения большого файла без копирования
+// строк есть ViewNode из json_view.h
 class Node final
     : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string> {
 public:
@@ -111,6 +179,87 @@ public:
     }
 };
 
+template <typename Key, typename Value>
+typename BasicDict<Key, Value>::const_iterator BasicDict<Key, Value>::LowerBound(std::string_view key) const {
+    return std::lower_bound(items_.begin(), items_.end(), key,
+                            [](const value_type& item, std::string_view k) {
+                                return std::string_view(item.first) < k;
+                            });
+}
+
+template <typename Key, typename Value>
+typename BasicDict<Key, Value>::iterator BasicDict<Key, Value>::LowerBound(std::string_view key) {
+    const auto it = std::as_const(*this).LowerBound(key);
+    return items_.begin() + (it - items_.cbegin());
+}
+
+template <typename Key, typename Value>
+typename BasicDict<Key, Value>::const_iterator BasicDict<Key, Value>::find(std::string_view key) const {
+    const auto it = LowerBound(key);
+    return it != items_.end() && it->first == key ? it : items_.end();
+}
+
+template <typename Key, typename Value>
+typename BasicDict<Key, Value>::iterator BasicDict<Key, Value>::find(std::string_view key) {
+    const auto it = LowerBound(key);
+    return it != items_.end() && it->first == key ? it : items_.end();
+}
+
+template <typename Key, typename Value>
+size_t BasicDict<Key, Value>::count(std::string_view key) const {
+    return find(key) != end() ? 1 : 0;
+}
+
+template <typename Key, typename Value>
+const Value& BasicDict<Key, Value>::at(std::string_view key) const {
+    const auto it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("Dict::at: no such key");
+    }
+    return it->second;
+}
+
+template <typename Key, typename Value>
+template <typename K, typename V>
+std::pair<typename BasicDict<Key, Value>::iterator, bool> BasicDict<Key, Value>::emplace(K&& key, V&& value) {
+    // Ключи во входных данных обычно уже упорядочены: вставка в конец без поиска
+    if (items_.empty() || std::string_view(items_.back().first) < std::string_view(key)) {
+        items_.emplace_back(std::forward<K>(key), std::forward<V>(value));
+        return {std::prev(items_.end()), true};
+    }
+    const auto it = LowerBound(key);
+    if (it != items_.end() && it->first == std::string_view(key)) {
+        return {it, false};
+    }
+    return {items_.emplace(it, std::forward<K>(key), std::forward<V>(value)), true};
+}
+
+template <typename Key, typename Value>
+void BasicDict<Key, Value>::AppendUnordered(Key key, Value value) {
+    items_.emplace_back(std::move(key), std::move(value));
+}
+
+template <typename Key, typename Value>
+const Key* BasicDict<Key, Value>::SortKeys() {
+    const auto key_less = [](const value_type& lhs, const value_type& rhs) {
+        return lhs.first < rhs.first;
+    };
+    // Обычно ключи во входных данных уже упорядочены, тогда хватает одного прохода
+    if (!std::is_sorted(items_.begin(), items_.end(), key_less)) {
+        std::sort(items_.begin(), items_.end(), key_less);
+    }
+    const auto duplicate = std::adjacent_find(items_.begin(), items_.end(),
+        [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first == rhs.first;
+        });
+    return duplicate != items_.end() ? &duplicate->first : nullptr;
+}
+
+template <typename Key, typename Value>
+bool BasicDict<Key, Value>::operator==(const BasicDict& rhs) const {
+    return items_ == rhs.items_;
+}
+
 inline bool operator!=(const Node& lhs, const Node& rhs) {
     return !(lhs == rhs);
 }
@@ -137,7 +286,19 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
     return !(lhs == rhs);
 }
 
+// Способ разбора документа, находящегося в памяти. Оба дают одинаковые
+// документы и одинаковые ParsingError
+enum class ParserKind {
+    RECURSIVE,          // рекурсивный спуск с посимвольным просмотром
+    STRUCTURAL_INDEX,   // SIMD-индекс структурных символов, затем обход индекса
+};
+
 Document Load(std::istream& input);
+// Разбирает документ, целиком находящийся в памяти. С пулом потоков большие
+// массивы верхнего уровня разбираются параллельно; результат тот же, что и без него
+Document Load(std::string_view input, ParserKind kind = ParserKind::RECURSIVE, ThreadPool* pool = nullptr);
+// Отображает файл в память и разбирает его без промежуточного потока
+Document LoadFile(const std::string& path, ParserKind kind = ParserKind::RECURSIVE, ThreadPool* pool = nullptr);
 
 void Print(const Document& doc, std::ostream& output);
 
@@ -0,0 +1,236 @@
+#include "json_index.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_INDEX_SSE2
+#endif
+
+namespace json {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+
+// Маски классов символов одного 64-байтного блока: бит i соответствует байту i
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0;
+    uint64_t whitespace = 0;
+    uint64_t newline = 0;
+};
+
+#if defined(__AVX2__)
+
+uint64_t Mask(__m256i lo, __m256i hi) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(lo))
+        | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hi))) << 32);
+}
+
+BlockMasks ClassifyBlock(const char* block) {
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    auto eq = [&](char c) {
+        const __m256i v = _mm256_set1_epi8(c);
+        return Mask(_mm256_cmpeq_epi8(lo, v), _mm256_cmpeq_epi8(hi, v));
+    };
+    // '[' | 0x20 == '{', ']' | 0x20 == '}'
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i lo_l = _mm256_or_si256(lo, lower);
+    const __m256i hi_l = _mm256_or_si256(hi, lower);
+    auto eq_lower = [&](char c) {
+        const __m256i v = _mm256_set1_epi8(c);
+        return Mask(_mm256_cmpeq_epi8(lo_l, v), _mm256_cmpeq_epi8(hi_l, v));
+    };
+    // \t \n \v \f \r — это байты 9..13
+    auto in_control_space = [&](__m256i x) {
+        const __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(9));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+    };
+
+    BlockMasks masks;
+    masks.quote = eq('"');
+    masks.backslash = eq('\\');
+    masks.structural = eq_lower('{') | eq_lower('}') | eq(':') | eq(',');
+    masks.newline = eq('\n') | eq('\r');
+    masks.whitespace = eq(' ') | Mask(in_control_space(lo), in_control_space(hi));
+    return masks;
+}
+
+#elif defined(JSON_INDEX_SSE2)
+
+uint64_t Mask(__m128i a, __m128i b, __m128i c, __m128i d) {
+    return static_cast<uint64_t>(_mm_movemask_epi8(a))
+        | (static_cast<uint64_t>(_mm_movemask_epi8(b)) << 16)
+        | (static_cast<uint64_t>(_mm_movemask_epi8(c)) << 32)
+        | (static_cast<uint64_t>(_mm_movemask_epi8(d)) << 48);
+}
+
+BlockMasks ClassifyBlock(const char* block) {
+    __m128i in[4];
+    __m128i in_l[4];
+    const __m128i lower = _mm_set1_epi8(0x20);
+    for (int i = 0; i < 4; ++i) {
+        in[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        in_l[i] = _mm_or_si128(in[i], lower);
+    }
+    auto eq = [](const __m128i* src, char c) {
+        const __m128i v = _mm_set1_epi8(c);
+        return Mask(_mm_cmpeq_epi8(src[0], v), _mm_cmpeq_epi8(src[1], v),
+                    _mm_cmpeq_epi8(src[2], v), _mm_cmpeq_epi8(src[3], v));
+    };
+    auto in_control_space = [](__m128i x) {
+        const __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(9));
+        return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    };
+
+    BlockMasks masks;
+    masks.quote = eq(in, '"');
+    masks.backslash = eq(in, '\\');
+    masks.structural = eq(in_l, '{') | eq(in_l, '}') | eq(in, ':') | eq(in, ',');
+    masks.newline = eq(in, '\n') | eq(in, '\r');
+    masks.whitespace = eq(in, ' ')
+        | Mask(in_control_space(in[0]), in_control_space(in[1]),
+               in_control_space(in[2]), in_control_space(in[3]));
+    return masks;
+}
+
+#else
+
+BlockMasks ClassifyBlock(const char* block) {
+    BlockMasks masks;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        const uint64_t bit = uint64_t{1} << i;
+        switch (block[i]) {
+            case '"':
+                masks.quote |= bit;
+                break;
+            case '\\':
+                masks.backslash |= bit;
+                break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                masks.structural |= bit;
+                break;
+            case '\n': case '\r':
+                masks.newline |= bit;
+                masks.whitespace |= bit;
+                break;
+            case ' ': case '\t': case '\v': case '\f':
+                masks.whitespace |= bit;
+                break;
+            default:
+                break;
+        }
+    }
+    return masks;
+}
+
+#endif
+
+// Бит i результата — XOR битов 0..i аргумента
+uint64_t PrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+int CountTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Состояние, переносимое между соседними блоками
+class Scanner {
+public:
+    explicit Scanner(StructuralIndex& index)
+        : index_(index) {
+    }
+
+    void ScanBlock(const char* block, uint32_t offset) {
+        const BlockMasks masks = ClassifyBlock(block);
+
+        const uint64_t escaped = FindEscaped(masks.backslash);
+        const uint64_t quotes = masks.quote & ~escaped;
+        // Бит установлен для открывающей кавычки и содержимого строки
+        const uint64_t in_string = PrefixXor(quotes) ^ prev_in_string_;
+        prev_in_string_ = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+        const uint64_t scalar = ~(masks.structural | masks.whitespace | masks.quote) & ~in_string;
+        const uint64_t scalar_starts = scalar & ~((scalar << 1) | prev_scalar_);
+        prev_scalar_ = scalar >> 63;
+
+        uint64_t bits = (masks.structural & ~in_string)
+            | quotes
+            | ((masks.backslash | masks.newline) & in_string)
+            | scalar_starts;
+
+        while (bits != 0) {
+            index_.push_back(offset + static_cast<uint32_t>(CountTrailingZeros(bits)));
+            bits &= bits - 1;
+        }
+    }
+
+private:
+    // Маска символов, экранированных обратным слэшем. Слэши в данных
+    // встречаются редко, поэтому достаточно простого цикла по их битам
+    uint64_t FindEscaped(uint64_t backslash) {
+        uint64_t escaped = prev_escaped_;
+        prev_escaped_ = 0;
+        backslash &= ~escaped;
+        while (backslash != 0) {
+            const int i = CountTrailingZeros(backslash);
+            if (i == 63) {
+                prev_escaped_ = 1;
+                break;
+            }
+            const uint64_t next = uint64_t{1} << (i + 1);
+            escaped |= next;
+            backslash &= ~((uint64_t{1} << i) | next);
+        }
+        return escaped;
+    }
+
+    StructuralIndex& index_;
+    uint64_t prev_in_string_ = 0;
+    uint64_t prev_scalar_ = 0;
+    uint64_t prev_escaped_ = 0;
+};
+
+}  // namespace
+
+StructuralIndex BuildStructuralIndex(std::string_view input) {
+    StructuralIndex index;
+    index.reserve(input.size() / 8);
+    Scanner scanner(index);
+
+    size_t offset = 0;
+    for (; offset + BLOCK_SIZE <= input.size(); offset += BLOCK_SIZE) {
+        scanner.ScanBlock(input.data() + offset, static_cast<uint32_t>(offset));
+    }
+    if (offset < input.size()) {
+        // Хвост дополняется пробелами, которые не попадают в индекс
+        char tail[BLOCK_SIZE];
+        std::memset(tail, ' ', BLOCK_SIZE);
+        std::memcpy(tail, input.data() + offset, input.size() - offset);
+        scanner.ScanBlock(tail, static_cast<uint32_t>(offset));
+    }
+    return index;
+}
+
+}  // namespace json
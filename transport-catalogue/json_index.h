@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+// Первая стадия разбора: индекс позиций, на которых второй стадии
+// нужно принять решение. В индекс попадают:
+//  - символы { } [ ] : , вне строк;
+//  - неэкранированные кавычки (и открывающие, и закрывающие);
+//  - обратные слэши и переводы строк внутри строк;
+//  - первые символы чисел и литералов (после пробела или структурного символа).
+// Всё остальное — пробелы и содержимое «чистых» строк — вторая стадия
+// пропускает без посимвольного просмотра.
+// Вход обрабатывается блоками по 64 байта: классы символов считаются
+// SIMD-сравнениями (SSE2/AVX2) и упаковываются в 64-битные маски.
+using StructuralIndex = std::vector<uint32_t>;
+
+StructuralIndex BuildStructuralIndex(std::string_view input);
+
+}  // namespace json
@@ -1,24 +1,44 @@
 #include "json_reader.h"
-#include "log_duration.h"
-#include <sstream>
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
 using namespace std::literals;
 
-void BaseRequestsHandler::Parse(const json::Node& base_requests) {
+// Типы всех запросов проверяются до того, как справочник начнёт меняться
+template <typename NodeType>
+void BaseRequestsHandler::LoadRequests(const NodeType& base_requests) {
+    std::vector<const NodeType*> stop_requests;
+    std::vector<const NodeType*> bus_requests;
     for (const auto& request : base_requests.AsArray()) {
-        const auto& request_map = request.AsMap();
-        const std::string& type = request_map.at("type").AsString();
+        const std::string_view type = request.AsMap().at("type").AsString();
 
-        if (type == "Stop") {
-            stop_requests_.push_back(request);
-        } else if (type == "Bus") {
-            bus_requests_.push_back(request);
+        if (type == "Stop"sv) {
+            stop_requests.push_back(&request);
+        } else if (type == "Bus"sv) {
+            bus_requests.push_back(&request);
         }
     }
+
+    MEASURE_PHASE("catalogue_load");
+    for (const NodeType* stop_request : stop_requests) {
+        ParseStop(*stop_request);
+    }
+    {
+        MEASURE_PHASE("distance_resolution");
+        catalogue_.SetDistance();
+    }
+    for (const NodeType* bus_request : bus_requests) {
+        ParseBus(*bus_request);
+    }
 }
 
-void BaseRequestsHandler::ParseStop(const json::Node& stop_request) {
+template <typename NodeType>
+void BaseRequestsHandler::ParseStop(const NodeType& stop_request) {
     const auto& stop_map = stop_request.AsMap();
-    const std::string& name = stop_map.at("name").AsString();
+    const std::string_view name = stop_map.at("name").AsString();
     double latitude = stop_map.at("latitude").AsDouble();
     double longitude = stop_map.at("longitude").AsDouble();
 
@@ -31,36 +51,138 @@ void BaseRequestsHandler::ParseStop(const json::Node& stop_request) {
     }
 }
 
-void BaseRequestsHandler::ParseBus(const json::Node& bus_request) {
+template <typename NodeType>
+void BaseRequestsHandler::ParseBus(const NodeType& bus_request) {
     const auto& bus_map = bus_request.AsMap();
-    const std::string& name = bus_map.at("name").AsString();
+    const std::string_view name = bus_map.at("name").AsString();
     bool is_roundtrip = bus_map.at("is_roundtrip").AsBool();
-    std::vector<std::string> stop_names;
+    const auto& stops = bus_map.at("stops").AsArray();
+    std::vector<std::string_view> stop_names;
+    stop_names.reserve(stops.size());
 
-    for (const auto& stop_node : bus_map.at("stops").AsArray()) {
+    for (const auto& stop_node : stops) {
         stop_names.push_back(stop_node.AsString());
     }
 
     catalogue_.AddBus(name, stop_names, is_roundtrip);
 }
 
-void BaseRequestsHandler::Process() {
-    for (const auto& stop_request : stop_requests_) {
-        ParseStop(stop_request);
-    }
-    catalogue_.SetDistance();
-    for (const auto& bus_request : bus_requests_) {
-        ParseBus(bus_request);
-    }
+void BaseRequestsHandler::Load(const json::Node& base_requests) {
+    LoadRequests(base_requests);
+}
+
+void BaseRequestsHandler::Load(const json::ViewNode& base_requests) {
+    LoadRequests(base_requests);
 }
 
 void StatRequestsHandler::Parse(const json::Node& stat_requests) {
     if (stat_requests.IsArray()) {
+        parsed_requests_.reserve(parsed_requests_.size() + stat_requests.AsArray().size());
         for (const auto& request : stat_requests.AsArray()) {
-            parsed_requests_.push_back(request);
+            if (!request.IsMap()) {
+                continue;
+            }
+            if (auto parsed = ParseRequest(request.AsMap())) {
+                parsed_requests_.push_back(*parsed);
+            }
         }
+    } else if (stat_requests.IsMap()) {
+        if (auto parsed = ParseRequest(stat_requests.AsMap())) {
+            parsed_requests_.push_back(*parsed);
+        }
+    }
+}
+
+// Запросы к MapRenderer меняют его кеши, поэтому выполняются только вызывающим потоком
+template <typename Query>
+constexpr bool IS_MAP_QUERY = std::is_same_v<Query, MapQuery> || std::is_same_v<Query, TileQuery>;
+
+static bool IsMapRequest(const StatRequest& request) {
+    return std::holds_alternative<MapQuery>(request) || std::holds_alternative<TileQuery>(request);
+}
+
+// Имена типов для metrics::Registry в порядке альтернатив StatRequest
+static constexpr std::array<std::string_view, std::variant_size_v<StatRequest>> REQUEST_TYPES = {
+    "Bus", "Stop", "Route", "Map", "Tile", "Stats", "Invalid"
+};
+
+// Задержки копятся локально и вливаются в реестр один раз на пачку запросов
+using RequestLatencies = std::array<metrics::Histogram, std::variant_size_v<StatRequest>>;
+
+static int GetRequestId(const StatRequest& request) {
+    return std::visit([](const auto& query) {
+        return query.id;
+    }, request);
+}
+
+// Задержка запроса в гистограмму его типа и, если включена трассировка, интервал в trace
+static void RecordRequest(RequestLatencies& latencies, const StatRequest& request,
+                          metrics::Clock::time_point start) {
+    const auto end = metrics::Clock::now();
+    latencies[request.index()].Record(end - start);
+    if (trace::IsEnabled()) {
+        trace::Record(REQUEST_TYPES[request.index()], start, end, GetRequestId(request));
     }
 }
+
+static void MergeLatencies(const RequestLatencies& latencies) {
+    for (size_t i = 0; i < latencies.size(); ++i) {
+        metrics::Registry::Instance().MergeRequests(REQUEST_TYPES[i], latencies[i]);
+    }
+}
+
+// {"min_lat", "min_lng", "max_lat", "max_lng"} и необязательные "width", "height".
+// invalid_argument, если min больше max или размер не положителен
+static MapViewport ParseViewport(const json::Dict& viewport_map) {
+    MapViewport viewport;
+    viewport.box = {viewport_map.at("min_lat").AsDouble(), viewport_map.at("min_lng").AsDouble(),
+                    viewport_map.at("max_lat").AsDouble(), viewport_map.at("max_lng").AsDouble()};
+    if (viewport.box.min_lat > viewport.box.max_lat || viewport.box.min_lng > viewport.box.max_lng) {
+        throw std::invalid_argument("Map viewport has min greater than max"s);
+    }
+    if (viewport_map.count("width") > 0) {
+        viewport.width = viewport_map.at("width").AsDouble();
+        if (!(*viewport.width > 0)) {
+            throw std::invalid_argument("Map viewport width must be positive"s);
+        }
+    }
+    if (viewport_map.count("height") > 0) {
+        viewport.height = viewport_map.at("height").AsDouble();
+        if (!(*viewport.height > 0)) {
+            throw std::invalid_argument("Map viewport height must be positive"s);
+        }
+    }
+    return viewport;
+}
+
+std::optional<StatRequest> StatRequestsHandler::ParseRequest(const json::Dict& request) const {
+    int request_id = request.at("id").AsInt();
+    const std::string& type = request.at("type").AsString();
+
+    if (type == "Bus") {
+        return BusQuery{request_id, catalogue_.FindBus(request.at("name").AsString())};
+    } else if (type == "Stop") {
+        return StopQuery{request_id, catalogue_.FindStop(request.at("name").AsString())};
+    } else if (type == "Route") {
+        return RouteQuery{request_id,
+                          catalogue_.FindStop(request.at("from").AsString()),
+                          catalogue_.FindStop(request.at("to").AsString())};
+    } else if (type == "Map") {
+        if (request.count("viewport") == 0) {
+            return MapQuery{request_id, std::nullopt};
+        }
+        try {
+            return MapQuery{request_id, ParseViewport(request.at("viewport").AsMap())};
+        } catch (const std::invalid_argument& e) {
+            return InvalidQuery{request_id, e.what()};
+        }
+    } else if (type == "Tile") {
+        return TileQuery{request_id, {request.at("z").AsInt(), request.at("x").AsInt(), request.at("y").AsInt()}};
+    } else if (type == "Stats") {
+        return StatsQuery{request_id};
+    }
+    return std::nullopt;
+}
 void StatRequestsHandler::SetRoutingSettings(const json::Node& routing_settings){
     double wait_time = routing_settings.AsMap().at("bus_wait_time").AsDouble();
     double velocity = routing_settings.AsMap().at("bus_velocity").AsDouble();
@@ -72,161 +194,373 @@ void StatRequestsHandler::InitializeMap(const json::Node& render_settings){
 }
 
 
-json::Node StatRequestsHandler::ProcessBusRequest(int request_id, const std::string& bus_name) const{
-    auto bus_info = catalogue_.GetBusInfo(bus_name);
-    if (bus_info) {
-        
-       return json::Builder{}.StartDict()
-       .Key("request_id").Value(request_id)
-       .Key("stop_count").Value(bus_info->stop_count)
-       .Key("unique_stop_count").Value(bus_info->unique_stops)
-       .Key("route_length").Value(bus_info->route_length)
-       .Key("curvature").Value(bus_info->curvature)
-       .EndDict().Build();
-    } else {
-        
-        return json::Builder{}.StartDict()
-        .Key("request_id").Value(request_id)
-        .Key("error_message").Value("not found")
-        .EndDict().Build();
-    }
-}
-
-json::Node StatRequestsHandler::ProcessStopRequest(int request_id, const std::string& stop_name) const {
-    const auto* buses_for_stop = catalogue_.GetBusesForStop(stop_name);
-    if (buses_for_stop) {
-        
-        auto builder = json::Builder{};
-        builder.StartDict()
-        .Key("buses").StartArray();
-        for(const auto bus_name: *buses_for_stop){
-            builder.Value(std::string(bus_name));
-        }
-        return builder.EndArray()
-        .Key("request_id").Value(request_id)
-        .EndDict().Build();
-        
+void StatRequestsHandler::WriteNotFound(json::Writer& writer, int request_id){
+    metrics::Registry::Instance().Increment("not_found");
+    writer.StartDict()
+    .Key("error_message").Value("not found")
+    .Key("request_id").Value(request_id)
+    .EndDict();
+}
+
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const BusQuery& query) const{
+    if (!query.bus) {
+        WriteNotFound(writer, query.id);
+        return;
     }
-    else if(catalogue_.FindStop(stop_name)!=nullptr){
-        
-        return json::Builder{}.StartDict()
-        .Key("buses").StartArray().EndArray()
-        .Key("request_id").Value(request_id)
-        .EndDict().Build();
+    const BusInfo bus_info = catalogue_.GetBusInfo(*query.bus);
+    writer.StartDict()
+    .Key("curvature").Value(bus_info.curvature)
+    .Key("request_id").Value(query.id)
+    .Key("route_length").Value(bus_info.route_length)
+    .Key("stop_count").Value(bus_info.stop_count)
+    .Key("unique_stop_count").Value(bus_info.unique_stops)
+    .EndDict();
+}
 
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const StopQuery& query) const {
+    if (!query.stop) {
+        WriteNotFound(writer, query.id);
+        return;
     }
-    
-    return json::Builder{}.StartDict()
-    .Key("request_id").Value(request_id)
-    .Key("error_message").Value("not found")
-    .EndDict().Build();
+    writer.StartDict()
+    .Key("buses").StartArray();
+    if (const auto* buses_for_stop = catalogue_.GetBusesForStop(*query.stop)) {
+        for (const auto bus_name : *buses_for_stop) {
+            writer.Value(bus_name);
+        }
+    }
+    writer.EndArray()
+    .Key("request_id").Value(query.id)
+    .EndDict();
 }
 
 
-json::Node StatRequestsHandler::ProcessRouteRequest(int request_id, const std::string& from, const std::string& to)const{
-    if(catalogue_.StopIsUseless(from) || catalogue_.StopIsUseless(to)){
-        return json::Builder{}.StartDict()
-        .Key("request_id").Value(request_id)
-        .Key("error_message").Value("not found")
-        .EndDict().Build();
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const RouteQuery& query)const{
+    // Остановка, через которую не проходит ни один автобус, недостижима
+    if(!query.from || !query.to
+       || !catalogue_.GetBusesForStop(*query.from) || !catalogue_.GetBusesForStop(*query.to)){
+        WriteNotFound(writer, query.id);
+        return;
     }
     
-    if(from == to){
-        return json::Builder{}.StartDict()
-        .Key("request_id").Value(request_id)
-        .Key("total_time").Value(0)
+    if(query.from == query.to){
+        writer.StartDict()
         .Key("items").StartArray().EndArray()
-        .EndDict()
-        .Build();
+        .Key("request_id").Value(query.id)
+        .Key("total_time").Value(0)
+        .EndDict();
+        return;
     }
     
-    
-    const auto& builder = ts_router_->BuildRoute(from, to, request_id);
-    if(builder.has_value()){
-        return builder.value();
+    const TransportRouter& router = GetRouter();
+    const auto route = router.BuildRoute(query.from->name, query.to->name);
+    if(!route){
+        WriteNotFound(writer, query.id);
+        return;
     }
-    
+    const auto& graph = router.GetGraph();
+    double total_time = 0.0;
+    writer.StartDict()
+    .Key("items").StartArray();
+    for(const graph::EdgeId edge_id: route->edges){
+        const auto& edge = graph.GetEdge(edge_id);
+        if(edge.span_count != 0){
+            writer.StartDict()
+            .Key("bus").Value(edge.name)
+            .Key("span_count").Value(static_cast<int>(edge.span_count))
+            .Key("time").Value(edge.weight)
+            .Key("type").Value("Bus")
+            .EndDict();
+        }
+        else{
+            writer.StartDict()
+            .Key("stop_name").Value(edge.name)
+            .Key("time").Value(edge.weight)
+            .Key("type").Value("Wait")
+            .EndDict();
+        }
+        total_time += edge.weight;
+    }
+    writer.EndArray()
+    .Key("request_id").Value(query.id)
+    .Key("total_time").Value(total_time)
+    .EndDict();
+}
+
+
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const MapQuery& query, ThreadPool* pool){
+    if (query.viewport) {
+        // Часть карты не кешируется: у каждого запроса свой прямоугольник
+        std::string map_json = "\"";
+        {
+            json::EscapingStreamBuf buffer(map_json);
+            std::ostream out(&buffer);
+            map_.DrawViewport(out, *query.viewport);
+        }
+        map_json += '"';
+        writer.StartDict()
+        .Key("map").RawValue(map_json)
+        .Key("request_id").Value(query.id)
+        .EndDict();
+        return;
+    }
+    writer.StartDict()
+    .Key("map").RawValue(map_.GetMapAsJsonString(pool))
+    .Key("request_id").Value(query.id)
+    .EndDict();
+}
 
-    return json::Builder{}.StartDict()
-        .Key("request_id").Value(request_id)
-        .Key("error_message").Value("not found")
-        .EndDict().Build();
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const TileQuery& query, ThreadPool*){
+    const std::optional<std::string> tile = tile_cache_.GetTile(query.tile);
+    if (!tile) {
+        WriteNotFound(writer, query.id);
+        return;
+    }
+    std::string tile_json = "\"";
+    json::AppendEscaped(tile_json, *tile);
+    tile_json += '"';
+    writer.StartDict()
+    .Key("map").RawValue(tile_json)
+    .Key("request_id").Value(query.id)
+    .EndDict();
 }
 
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const StatsQuery& query) const {
+    writer.StartDict()
+    .Key("metrics");
+    metrics::Registry::Instance().Write(writer);
+    writer.Key("request_id").Value(query.id)
+    .EndDict();
+}
 
-json::Node StatRequestsHandler::ProcessMapRequest(int request_id){
-    std::ostringstream oss;
-    map_.DrawMap(oss);
-    
-    
-    return json::Builder{}.StartDict()
-    .Key("map").Value(oss.str())
-    .Key("request_id").Value(request_id)
-    .EndDict().Build();
+void StatRequestsHandler::ProcessRequest(json::Writer& writer, const InvalidQuery& query) const {
+    metrics::Registry::Instance().Increment("invalid_requests");
+    writer.StartDict()
+    .Key("error_message").Value(query.error_message)
+    .Key("request_id").Value(query.id)
+    .EndDict();
 }
 
-void StatRequestsHandler::BuildGraph(){
-    
-    ts_router_ = new TransportRouter(catalogue_);
-    
+void StatRequestsHandler::SetTileCacheDirectory(std::filesystem::path directory){
+    tile_cache_.SetDirectory(std::move(directory));
+}
+
+TileCache::GenerateStats StatRequestsHandler::GenerateTiles(int max_zoom, ThreadPool* pool){
+    return tile_cache_.Generate(max_zoom, pool);
+}
+
+void StatRequestsHandler::ResetRouter(){
+    // Фоновое построение читает справочник, поэтому менять его можно только после завершения
+    if (router_build_.valid()) {
+        router_build_.wait();
+        router_build_ = {};
+    }
+    ts_router_.reset();
+}
+
+void StatRequestsHandler::BuildRouter(){
+    if (router_build_.valid()) {
+        // get, а не wait: исключение из фонового построения передаётся вызывающему
+        router_build_.get();
+        return;
+    }
+    if (!ts_router_) {
+        ts_router_ = std::make_unique<TransportRouter>(catalogue_);
+    }
+}
+
+void StatRequestsHandler::StartRouterBuild(){
+    if (ts_router_ || router_build_.valid()) {
+        return;
+    }
+    // Отдельный поток, а не пул: рабочие потоки пула ждут готовности
+    // маршрутизатора и не должны занимать место самого построения
+    router_build_ = std::async(std::launch::async, [this] {
+        ts_router_ = std::make_unique<TransportRouter>(catalogue_);
+    }).share();
 }
 
-std::vector<json::Node> StatRequestsHandler::Process(){
-    std::vector<json::Node> responses;
+const TransportRouter& StatRequestsHandler::GetRouter() const{
+    if (router_build_.valid()) {
+        router_build_.get();
+    }
+    if (!ts_router_) {
+        throw std::logic_error("Router is not built"s);
+    }
+    return *ts_router_;
+}
 
+void StatRequestsHandler::Process(json::Writer& writer, ThreadPool* pool){
+    MEASURE_PHASE("stat_requests");
+    const bool has_routes = std::any_of(parsed_requests_.begin(), parsed_requests_.end(),
+        [](const StatRequest& request) {
+            return std::holds_alternative<RouteQuery>(request);
+        });
+    if (pool != nullptr && parsed_requests_.size() > 1) {
+        // Маршрутизатор строится одновременно с ответами на Bus и Stop
+        if (has_routes) {
+            StartRouterBuild();
+        }
+        ProcessParallel(writer, *pool);
+        return;
+    }
+    if (has_routes) {
+        BuildRouter();
+    }
+    RequestLatencies latencies;
     for (const auto& request : parsed_requests_) {
-        if (request.IsMap()) {
-            const auto& request_map = request.AsMap();
-            int request_id = request_map.at("id").AsInt();
-            const std::string& type = request_map.at("type").AsString();
-
-            if (type == "Bus") {
-                responses.push_back(ProcessBusRequest(request_id, request_map.at("name").AsString()));
-                
-            } else if (type == "Stop") {
-                responses.push_back(ProcessStopRequest(request_id, request_map.at("name").AsString()));
-                
+        const auto start = metrics::Clock::now();
+        std::visit([this, &writer, pool](const auto& query) {
+            if constexpr (IS_MAP_QUERY<std::decay_t<decltype(query)>>) {
+                ProcessRequest(writer, query, pool);
+            } else {
+                ProcessRequest(writer, query);
             }
-            else if(type == "Map"){
-                responses.push_back(ProcessMapRequest(request_id));
-                
+        }, request);
+        RecordRequest(latencies, request, start);
+    }
+    MergeLatencies(latencies);
+    parsed_requests_.clear();
+}
+
+void StatRequestsHandler::ProcessParallel(json::Writer& writer, ThreadPool& pool){
+    static constexpr size_t TASKS_PER_THREAD = 8;
+    static constexpr size_t MIN_BATCH_SIZE = 16;
+
+    // Ответы пишутся в заранее выделенные ячейки по номеру запроса.
+    // Запросы Map и Tile выполняет вызывающий поток;
+    // саму отрисовку карты он раскладывает по тому же пулу
+    const size_t count = parsed_requests_.size();
+    const size_t batch_size = std::max(MIN_BATCH_SIZE, count / (pool.Size() * TASKS_PER_THREAD) + 1);
+    std::vector<std::string> slots(count);
+    std::vector<std::future<void>> batches;
+    batches.reserve(count / batch_size + 1);
+    for (size_t begin = 0; begin < count; begin += batch_size) {
+        const size_t end = std::min(count, begin + batch_size);
+        batches.push_back(pool.Submit([this, &slots, begin, end] {
+            RequestLatencies latencies;
+            for (size_t i = begin; i < end; ++i) {
+                if (IsMapRequest(parsed_requests_[i])) {
+                    continue;
+                }
+                const auto start = metrics::Clock::now();
+                json::Writer slot_writer(1);
+                std::visit([this, &slot_writer](const auto& query) {
+                    if constexpr (!IS_MAP_QUERY<std::decay_t<decltype(query)>>) {
+                        ProcessRequest(slot_writer, query);
+                    }
+                }, parsed_requests_[i]);
+                slots[i] = slot_writer.Release();
+                RecordRequest(latencies, parsed_requests_[i], start);
             }
-            else if(type == "Route"){
-                responses.push_back(ProcessRouteRequest(request_id, request_map.at("from").AsString(), request_map.at("to").AsString()));
-                
+            MergeLatencies(latencies);
+        }));
+    }
+
+    // Ответы выводятся по порядку, по мере готовности очередной пачки
+    RequestLatencies map_latencies;
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            if (i % batch_size == 0) {
+                batches[i / batch_size].get();
+            }
+            if (IsMapRequest(parsed_requests_[i])) {
+                const auto start = metrics::Clock::now();
+                std::visit([this, &writer, &pool](const auto& query) {
+                    if constexpr (IS_MAP_QUERY<std::decay_t<decltype(query)>>) {
+                        ProcessRequest(writer, query, &pool);
+                    }
+                }, parsed_requests_[i]);
+                RecordRequest(map_latencies, parsed_requests_[i], start);
+            } else {
+                writer.RawValue(slots[i]);
+                std::string().swap(slots[i]);
             }
         }
+    } catch (...) {
+        // Задачи пула пишут в slots и читают parsed_requests_, поэтому до выхода
+        // из функции нужно дождаться всех, и только потом передать первое исключение
+        WaitAll(batches);
+        throw;
     }
-
-    return responses;
+    MergeLatencies(map_latencies);
+    parsed_requests_.clear();
 }
 
 
 
 
+// Настройки читает код для Node. Их разделы небольшие, и из ViewNode они просто копируются
+static const json::Node& AsNode(const json::Node& node) {
+    return node;
+}
+
+static json::Node AsNode(const json::ViewNode& node) {
+    return json::ToNode(node);
+}
+
+template <typename DictType>
+void RequestManager::LoadBaseFrom(const DictType& input_map) {
+    metrics::Registry::Instance().Increment("base_loads");
+    stat_requests_handler_.ResetRouter();
+    if (input_map.count("base_requests") > 0) {
+        base_requests_handler_.Load(input_map.at("base_requests"));
+    }
+    if (input_map.count("render_settings") > 0) {
+        stat_requests_handler_.InitializeMap(AsNode(input_map.at("render_settings")));
+    }
+    if (input_map.count("routing_settings") > 0) {
+        stat_requests_handler_.SetRoutingSettings(AsNode(input_map.at("routing_settings")));
+    }
+}
+
 void RequestManager::ProcessInput(const json::Node& input) {
     const auto& input_map = input.AsMap();
+    LoadBase(input_map);
+    ParseStatRequests(input_map.at("stat_requests"));
+}
 
-    
-    base_requests_handler_.Parse(input_map.at("base_requests"));
-    base_requests_handler_.Process();  
-    
-    
-    stat_requests_handler_.InitializeMap(input_map.at("render_settings"));
-    stat_requests_handler_.SetRoutingSettings(input_map.at("routing_settings"));
-    stat_requests_handler_.BuildGraph();
-    stat_requests_handler_.Parse(input_map.at("stat_requests"));
+void RequestManager::ProcessInput(const json::ViewNode& input) {
+    const auto& input_map = input.AsMap();
+    LoadBase(input_map);
+    // Разбор запросов написан для Node; stat_requests обычно много меньше base_requests
+    ParseStatRequests(json::ToNode(input_map.at("stat_requests")));
 }
 
-json::Node RequestManager::GetResponses() {
-    json::Array responses; 
-    for (const auto& response : stat_requests_handler_.Process()) {
-        responses.emplace_back(response);
-    }
-    
+void RequestManager::LoadBase(const json::Dict& input_map) {
+    LoadBaseFrom(input_map);
+}
+
+void RequestManager::LoadBase(const json::ViewDict& input_map) {
+    LoadBaseFrom(input_map);
+}
 
-    return json::Node(responses);
+void RequestManager::PrepareRouter() {
+    stat_requests_handler_.BuildRouter();
 }
 
+void RequestManager::SetTileCacheDirectory(std::filesystem::path directory) {
+    stat_requests_handler_.SetTileCacheDirectory(std::move(directory));
+}
+
+TileCache::GenerateStats RequestManager::GenerateTiles(int max_zoom, ThreadPool* pool) {
+    return stat_requests_handler_.GenerateTiles(max_zoom, pool);
+}
 
+void RequestManager::ParseStatRequests(const json::Node& stat_requests) {
+    stat_requests_handler_.Parse(stat_requests);
+}
 
+void RequestManager::WriteResponses(std::ostream& out, ThreadPool* pool) {
+    // Время самой записи в поток учитывается отдельно, как фаза print
+    metrics::TimedStreamBuf print_buffer(out.rdbuf(), "print");
+    std::ostream print_out(&print_buffer);
+    json::Writer writer(print_out);
+    writer.StartArray();
+    stat_requests_handler_.Process(writer, pool);
+    writer.EndArray();
+}
+
+void RequestManager::WriteResponses(json::Writer& writer, ThreadPool* pool) {
+    stat_requests_handler_.Process(writer, pool);
+}
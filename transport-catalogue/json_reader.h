@@ -1,48 +1,126 @@
 #pragma once
 #include "map_renderer.h"
-#include "json_builder.h"
+#include "tile_cache.h"
+#include "json_writer.h"
+#include "json_view.h"
 #include "router.h"
 #include "transport_router.h"
+#include "thread_pool.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <variant>
+#include <memory>
+#include <future>
 
 class BaseRequestsHandler {
 public:
     explicit BaseRequestsHandler(TransportCatalogue& catalogue)
         : catalogue_(catalogue) {}
 
-    void Parse(const json::Node& base_requests);
-    void Process();
+    // Добавляет в справочник сначала все остановки, затем расстояния и маршруты
+    void Load(const json::Node& base_requests);
+    void Load(const json::ViewNode& base_requests);
 
 private:
     TransportCatalogue& catalogue_;
-    std::vector<json::Node> stop_requests_;
-    std::vector<json::Node> bus_requests_;
-    void ParseStop(const json::Node& stop_request);
-    void ParseBus(const json::Node& bus_request);
+    template <typename NodeType>
+    void LoadRequests(const NodeType& base_requests);
+    template <typename NodeType>
+    void ParseStop(const NodeType& stop_request);
+    template <typename NodeType>
+    void ParseBus(const NodeType& bus_request);
 };
 
 
+// Запросы к справочнику, разобранные из stat_requests один раз.
+// Имена остановок и маршрутов уже разрешены в указатели на объекты справочника,
+// nullptr означает, что такого объекта нет
+struct BusQuery {
+    int id;
+    const Bus* bus;
+};
+
+struct StopQuery {
+    int id;
+    const Stop* stop;
+};
+
+struct RouteQuery {
+    int id;
+    const Stop* from;
+    const Stop* to;
+};
+
+// Без viewport — вся карта, с ним — только заданная часть
+struct MapQuery {
+    int id;
+    std::optional<MapViewport> viewport;
+};
+
+struct TileQuery {
+    int id;
+    TileId tile;
+};
+
+// Снимок metrics::Registry: фазы, задержки запросов по типам и счётчики
+struct StatsQuery {
+    int id;
+};
+
+// Запрос с недопустимыми параметрами: ответом на него будет error_message,
+// остальные запросы пакета обрабатываются как обычно
+struct InvalidQuery {
+    int id;
+    std::string error_message;
+};
+
+using StatRequest = std::variant<BusQuery, StopQuery, RouteQuery, MapQuery, TileQuery, StatsQuery, InvalidQuery>;
+
 class StatRequestsHandler {
 public:
     explicit StatRequestsHandler(TransportCatalogue& catalogue)
-        : catalogue_(catalogue), map_(catalogue){}
+        : catalogue_(catalogue), map_(catalogue), tile_cache_(map_, {}){}
 
+    // Принимает массив запросов или один запрос-словарь
     void Parse(const json::Node& stat_requests);
     void SetRoutingSettings (const json::Node& routing_settings);
     void InitializeMap(const json::Node& render_settings);
-    std::vector<json::Node> Process();
-    void BuildGraph();
+    // Пишет ответ на каждый запрос в writer сразу, как только он готов.
+    // С пулом потоков запросы выполняются параллельно, порядок ответов сохраняется
+    void Process(json::Writer& writer, ThreadPool* pool = nullptr);
+    // Маршрутизатор строится лениво: при первом пакете с запросами Route.
+    // ResetRouter вызывается после изменения справочника или настроек маршрутов
+    void ResetRouter();
+    void BuildRouter();
+    void SetTileCacheDirectory(std::filesystem::path directory);
+    TileCache::GenerateStats GenerateTiles(int max_zoom, ThreadPool* pool);
+    size_t GetRequestsCount() const {
+        return parsed_requests_.size();
+    }
+    void ClearRequests() {
+        parsed_requests_.clear();
+    }
 private:
     TransportCatalogue& catalogue_;
-    std::vector<json::Node> parsed_requests_;
+    std::vector<StatRequest> parsed_requests_;
     MapRenderer map_;
-    TransportRouter* ts_router_ = nullptr;
-    json::Node ProcessBusRequest(int request_id, const std::string& bus_name)const;
-    json::Node ProcessStopRequest(int request_id, const std::string& stop_name)const;
-    json::Node ProcessRouteRequest(int request_id, const std::string& from, const std::string& to)const;
-    json::Node ProcessMapRequest(int request_id);
+    TileCache tile_cache_;
+    std::unique_ptr<TransportRouter> ts_router_;
+    // Готовность ts_router_, если он строится в отдельном потоке
+    std::shared_future<void> router_build_;
+    std::optional<StatRequest> ParseRequest(const json::Dict& request) const;
+    void ProcessRequest(json::Writer& writer, const BusQuery& query)const;
+    void ProcessRequest(json::Writer& writer, const StopQuery& query)const;
+    void ProcessRequest(json::Writer& writer, const RouteQuery& query)const;
+    void ProcessRequest(json::Writer& writer, const MapQuery& query, ThreadPool* pool);
+    void ProcessRequest(json::Writer& writer, const TileQuery& query, ThreadPool* pool);
+    void ProcessRequest(json::Writer& writer, const StatsQuery& query)const;
+    void ProcessRequest(json::Writer& writer, const InvalidQuery& query)const;
+    static void WriteNotFound(json::Writer& writer, int request_id);
+    void ProcessParallel(json::Writer& writer, ThreadPool& pool);
+    void StartRouterBuild();
+    const TransportRouter& GetRouter() const;
     
 };
 
@@ -53,9 +131,36 @@ public:
         : base_requests_handler_(catalogue), stat_requests_handler_(catalogue){}
 
     void ProcessInput(const json::Node& input);
-    json::Node GetResponses();
+    void ProcessInput(const json::ViewNode& input);
+    // Загружает base_requests и настройки из тех разделов, что есть в документе,
+    // и перестраивает маршрутизатор. Можно вызывать повторно, дополняя справочник
+    void LoadBase(const json::Dict& input);
+    // То же для документа из json::LoadFileView: имена не копируются лишний раз
+    void LoadBase(const json::ViewDict& input);
+    // Строит маршрутизатор сразу, не дожидаясь первого запроса Route
+    void PrepareRouter();
+    // Каталог дискового кеша плиток для запросов Tile; без него плитки не сохраняются
+    void SetTileCacheDirectory(std::filesystem::path directory);
+    // Заранее рисует в кеш плитки уровней 0..max_zoom
+    TileCache::GenerateStats GenerateTiles(int max_zoom, ThreadPool* pool = nullptr);
+    // Запоминает запросы пакета; ответы выдаёт следующий вызов WriteResponses
+    void ParseStatRequests(const json::Node& stat_requests);
+    // Отвечает на запомненные запросы и забывает их
+    void WriteResponses(std::ostream& out, ThreadPool* pool = nullptr);
+    // То же, но ответы пишутся в writer отдельными значениями, без обрамляющего массива
+    void WriteResponses(json::Writer& writer, ThreadPool* pool = nullptr);
+    size_t GetPendingRequestsCount() const {
+        return stat_requests_handler_.GetRequestsCount();
+    }
+    // Забывает запомненные запросы без ответа — после ошибки в пакете,
+    // чтобы они не попали в ответ на следующий
+    void DiscardStatRequests() {
+        stat_requests_handler_.ClearRequests();
+    }
 
 private:
     BaseRequestsHandler base_requests_handler_;
     StatRequestsHandler stat_requests_handler_;
+    template <typename DictType>
+    void LoadBaseFrom(const DictType& input);
 };
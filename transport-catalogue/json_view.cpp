@@ -0,0 +1,46 @@
+#include "json_view.h"
+#include "mapped_file.h"
+
+#include <type_traits>
+
+namespace json {
+
+ViewDocument::ViewDocument(std::unique_ptr<MappedFile> file, std::unique_ptr<StringArena> strings, ViewNode root)
+    : file_(std::move(file))
+    , strings_(std::move(strings))
+    , root_(std::move(root)) {
+}
+
+ViewDocument::ViewDocument(ViewDocument&&) noexcept = default;
+ViewDocument& ViewDocument::operator=(ViewDocument&&) noexcept = default;
+ViewDocument::~ViewDocument() = default;
+
+Node ToNode(const ViewNode& node) {
+    return std::visit(
+        [](const auto& value) -> Node {
+            using Value = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<Value, ViewArray>) {
+                Array result;
+                result.reserve(value.size());
+                for (const ViewNode& item : value) {
+                    result.push_back(ToNode(item));
+                }
+                return result;
+            } else if constexpr (std::is_same_v<Value, ViewDict>) {
+                // Ключи уже упорядочены и не повторяются, emplace добавляет их в конец
+                Dict result;
+                result.reserve(value.size());
+                for (const auto& [key, item] : value) {
+                    result.emplace(std::string(key), ToNode(item));
+                }
+                return result;
+            } else if constexpr (std::is_same_v<Value, std::string_view>) {
+                return std::string(value);
+            } else {
+                return value;
+            }
+        },
+        node.GetValue());
+}
+
+}  // namespace json
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "json.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+class MappedFile;
+
+namespace json {
+
+class ViewNode;
+using ViewArray = std::vector<ViewNode>;
+using ViewDict = BasicDict<std::string_view, ViewNode>;
+
+// Строки с escape-последовательностями, которые нельзя показать прямо в буфер документа.
+// В справочниках их почти нет, поэтому общий мьютекс для частей параллельного разбора не мешает
+class StringArena {
+public:
+    std::string_view Store(std::string s) {
+        std::lock_guard lock(mutex_);
+        return strings_.emplace_back(std::move(s));
+    }
+
+private:
+    std::mutex mutex_;
+    // deque не перемещает уже добавленные строки
+    std::deque<std::string> strings_;
+};
+
+// Узел документа только для чтения: строки и ключи — string_view в отображённый файл
+// либо в StringArena документа. Интерфейс повторяет Node, кроме AsString, который
+// возвращает string_view. Узел действителен, пока жив его ViewDocument
+class ViewNode final
+    : private std::variant<std::nullptr_t, ViewArray, ViewDict, bool, int, double, std::string_view> {
+public:
+    using variant::variant;
+    using Value = variant;
+
+    bool IsInt() const {
+        return std::holds_alternative<int>(*this);
+    }
+    int AsInt() const {
+        using namespace std::literals;
+        if (!IsInt()) {
+            throw std::logic_error("Not an int"s);
+        }
+        return std::get<int>(*this);
+    }
+
+    bool IsPureDouble() const {
+        return std::holds_alternative<double>(*this);
+    }
+    bool IsDouble() const {
+        return IsInt() || IsPureDouble();
+    }
+    double AsDouble() const {
+        using namespace std::literals;
+        if (!IsDouble()) {
+            throw std::logic_error("Not a double"s);
+        }
+        return IsPureDouble() ? std::get<double>(*this) : AsInt();
+    }
+
+    bool IsBool() const {
+        return std::holds_alternative<bool>(*this);
+    }
+    bool AsBool() const {
+        using namespace std::literals;
+        if (!IsBool()) {
+            throw std::logic_error("Not a bool"s);
+        }
+        return std::get<bool>(*this);
+    }
+
+    bool IsNull() const {
+        return std::holds_alternative<std::nullptr_t>(*this);
+    }
+
+    bool IsArray() const {
+        return std::holds_alternative<ViewArray>(*this);
+    }
+    const ViewArray& AsArray() const {
+        using namespace std::literals;
+        if (!IsArray()) {
+            throw std::logic_error("Not an array"s);
+        }
+        return std::get<ViewArray>(*this);
+    }
+
+    bool IsString() const {
+        return std::holds_alternative<std::string_view>(*this);
+    }
+    std::string_view AsString() const {
+        using namespace std::literals;
+        if (!IsString()) {
+            throw std::logic_error("Not a string"s);
+        }
+        return std::get<std::string_view>(*this);
+    }
+
+    bool IsMap() const {
+        return std::holds_alternative<ViewDict>(*this);
+    }
+    const ViewDict& AsMap() const {
+        using namespace std::literals;
+        if (!IsMap()) {
+            throw std::logic_error("Not a dict"s);
+        }
+        return std::get<ViewDict>(*this);
+    }
+
+    const Value& GetValue() const {
+        return *this;
+    }
+};
+
+// Копия поддерева в обычный Node, например для настроек, которые разбираются кодом для Node
+Node ToNode(const ViewNode& node);
+
+// Документ вместе с буфером, на который ссылаются его строки
+class ViewDocument {
+public:
+    ViewDocument(std::unique_ptr<MappedFile> file, std::unique_ptr<StringArena> strings, ViewNode root);
+    ViewDocument(ViewDocument&&) noexcept;
+    ViewDocument& operator=(ViewDocument&&) noexcept;
+    ~ViewDocument();
+
+    const ViewNode& GetRoot() const {
+        return root_;
+    }
+
+private:
+    std::unique_ptr<MappedFile> file_;
+    std::unique_ptr<StringArena> strings_;
+    ViewNode root_;
+};
+
+// Разбирает документ тем же парсером, что и Load, но строки без escape-последовательностей
+// не копирует. input должен жить дольше документа
+ViewDocument LoadView(std::string_view input, ParserKind kind = ParserKind::RECURSIVE, ThreadPool* pool = nullptr);
+// Отображает файл в память; отображение принадлежит документу
+ViewDocument LoadFileView(const std::string& path, ParserKind kind = ParserKind::RECURSIVE, ThreadPool* pool = nullptr);
+
+}  // namespace json
@@ -0,0 +1,266 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <iterator>
+
+using namespace std::literals;
+namespace json {
+
+    namespace {
+
+        template <typename Number>
+        void AppendNumber(std::string& buffer, Number value) {
+            char chars[32];
+            const auto [ptr, ec] = std::to_chars(std::begin(chars), std::end(chars), value);
+            buffer.append(chars, ptr);
+        }
+
+    } // namespace
+
+    //---------------- Escaping ----------------
+
+    void AppendEscaped(std::string& out, std::string_view value) {
+        // Участки без спецсимволов копируются целиком
+        size_t run_begin = 0;
+        for (size_t i = 0; i < value.size(); ++i) {
+            std::string_view escape;
+            switch (value[i]) {
+                case '\r':
+                    escape = "\\r"sv;
+                    break;
+                case '\n':
+                    escape = "\\n"sv;
+                    break;
+                case '\t':
+                    escape = "\\t"sv;
+                    break;
+                case '"':
+                    escape = "\\\""sv;
+                    break;
+                case '\\':
+                    escape = "\\\\"sv;
+                    break;
+                default:
+                    continue;
+            }
+            out.append(value.data() + run_begin, i - run_begin);
+            out += escape;
+            run_begin = i + 1;
+        }
+        out.append(value.data() + run_begin, value.size() - run_begin);
+    }
+
+    EscapingStreamBuf::int_type EscapingStreamBuf::overflow(int_type ch) {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            const char c = traits_type::to_char_type(ch);
+            AppendEscaped(target_, std::string_view(&c, 1));
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize EscapingStreamBuf::xsputn(const char* data, std::streamsize size) {
+        AppendEscaped(target_, std::string_view(data, static_cast<size_t>(size)));
+        return size;
+    }
+
+    //---------------- Writer ----------------
+
+    Writer::Writer(std::ostream& out, Layout layout) :
+        out_{ &out },
+        compact_{ layout == Layout::COMPACT }
+    {
+        buffer_.reserve(FLUSH_THRESHOLD * 2);
+    }
+
+    Writer::Writer(size_t base_depth, Layout layout) :
+        base_depth_{ base_depth },
+        compact_{ layout == Layout::COMPACT }
+    {
+
+    }
+
+    Writer::~Writer() {
+        Flush();
+    }
+
+    Writer& Writer::StartArray() {
+        BeforeValue();
+        buffer_ += '[';
+        stack_.push_back({ false });
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        EndContainer(false, ']');
+        return *this;
+    }
+
+    Writer& Writer::StartDict() {
+        BeforeValue();
+        buffer_ += '{';
+        stack_.push_back({ true });
+        return *this;
+    }
+
+    Writer& Writer::EndDict() {
+        EndContainer(true, '}');
+        return *this;
+    }
+
+    Writer& Writer::Key(std::string_view key) {
+        if (stack_.empty() || !stack_.back().is_dict || key_written_) {
+            throw WriteError("Key is allowed only inside Dict"s);
+        }
+        Level& level = stack_.back();
+        if (!level.first) {
+            buffer_ += ',';
+        }
+        level.first = false;
+        WriteIndent(stack_.size());
+        WriteString(key);
+        buffer_ += compact_ ? ":"sv : ": "sv;
+        key_written_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(std::nullptr_t) {
+        BeforeValue();
+        buffer_ += "null"sv;
+        MaybeFlush();
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value) {
+        BeforeValue();
+        buffer_ += value ? "true"sv : "false"sv;
+        MaybeFlush();
+        return *this;
+    }
+
+    Writer& Writer::Value(int value) {
+        BeforeValue();
+        AppendNumber(buffer_, value);
+        MaybeFlush();
+        return *this;
+    }
+
+    Writer& Writer::Value(double value) {
+        BeforeValue();
+        AppendNumber(buffer_, value);
+        MaybeFlush();
+        return *this;
+    }
+
+    Writer& Writer::Value(std::string_view value) {
+        BeforeValue();
+        WriteString(value);
+        MaybeFlush();
+        return *this;
+    }
+
+    Writer& Writer::Value(const Node& value) {
+        if (value.IsArray()) {
+            StartArray();
+            for (const Node& item : value.AsArray()) {
+                Value(item);
+            }
+            return EndArray();
+        }
+        if (value.IsMap()) {
+            StartDict();
+            for (const auto& [key, item] : value.AsMap()) {
+                Key(key).Value(item);
+            }
+            return EndDict();
+        }
+        if (value.IsString()) {
+            return Value(std::string_view(value.AsString()));
+        }
+        if (value.IsBool()) {
+            return Value(value.AsBool());
+        }
+        if (value.IsInt()) {
+            return Value(value.AsInt());
+        }
+        if (value.IsPureDouble()) {
+            return Value(value.AsDouble());
+        }
+        return Value(nullptr);
+    }
+
+    Writer& Writer::RawValue(std::string_view json) {
+        BeforeValue();
+        buffer_ += json;
+        MaybeFlush();
+        return *this;
+    }
+
+    void Writer::Flush() {
+        if (out_ == nullptr) {
+            return;
+        }
+        out_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    std::string Writer::Release() {
+        std::string result = std::move(buffer_);
+        buffer_.clear();
+        return result;
+    }
+
+    void Writer::BeforeValue() {
+        if (stack_.empty()) {
+            return;
+        }
+        Level& level = stack_.back();
+        if (level.is_dict) {
+            if (!key_written_) {
+                throw WriteError("Value inside Dict requires a Key"s);
+            }
+            key_written_ = false;
+            return;
+        }
+        if (!level.first) {
+            buffer_ += ',';
+        }
+        level.first = false;
+        WriteIndent(stack_.size());
+    }
+
+    void Writer::EndContainer(bool is_dict, char close) {
+        if (stack_.empty() || stack_.back().is_dict != is_dict || key_written_) {
+            throw WriteError(is_dict ? "Can't close Dict"s : "Can't close Array"s);
+        }
+        // Пустой контейнер json::Print печатает с пустой строкой внутри
+        if (stack_.back().first && !compact_) {
+            buffer_ += '\n';
+        }
+        stack_.pop_back();
+        WriteIndent(stack_.size());
+        buffer_ += close;
+        MaybeFlush();
+    }
+
+    // Перевод строки и отступ перед очередным элементом или закрывающей скобкой
+    void Writer::WriteIndent(size_t depth) {
+        if (compact_) {
+            return;
+        }
+        buffer_ += '\n';
+        buffer_.append((base_depth_ + depth) * INDENT_STEP, ' ');
+    }
+
+    void Writer::WriteString(std::string_view value) {
+        buffer_ += '"';
+        AppendEscaped(buffer_, value);
+        buffer_ += '"';
+    }
+
+    void Writer::MaybeFlush() {
+        if (buffer_.size() >= FLUSH_THRESHOLD) {
+            Flush();
+        }
+    }
+
+} // namespace json
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "json.h"
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+    //----------------- Error ----------------
+
+    class WriteError : public std::logic_error {
+    public:
+        using logic_error::logic_error;
+    };
+
+    //---------------- Escaping ----------------
+
+    // Дописывает value в out, экранируя символы по правилам строки JSON (без кавычек)
+    void AppendEscaped(std::string& out, std::string_view value);
+
+    // Буфер потока, который экранирует всё, что в него пишут, и дописывает в target.
+    // Через него текст (например, SVG) сериализуется сразу строковым значением JSON,
+    // без промежуточной неэкранированной копии
+    class EscapingStreamBuf : public std::streambuf {
+    public:
+        explicit EscapingStreamBuf(std::string& target)
+            : target_(target) {}
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+    private:
+        std::string& target_;
+    };
+
+    //---------------- Writer ----------------
+
+    // PRETTY совпадает с json::Print, COMPACT пишет значение одной строкой
+    // без пробелов — для построчных протоколов
+    enum class Layout {
+        PRETTY,
+        COMPACT
+    };
+
+    // Потоковый сериализатор JSON. В отличие от Builder не строит дерево Node,
+    // а сразу пишет текст в буфер, который сбрасывается в поток порциями.
+    // Формат вывода совпадает с json::Print, поэтому ключи словаря
+    // вызывающий код должен передавать в порядке возрастания.
+    class Writer {
+    public:
+        explicit Writer(std::ostream& out, Layout layout = Layout::PRETTY);
+        // Пишет только во внутренний буфер, текст забирается через Release().
+        // base_depth — уровень вложенности, на котором окажется этот текст
+        // при вставке через RawValue в другой Writer
+        explicit Writer(size_t base_depth, Layout layout = Layout::PRETTY);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        Writer& StartArray();
+        Writer& EndArray();
+        Writer& StartDict();
+        Writer& EndDict();
+        Writer& Key(std::string_view key);
+
+        Writer& Value(std::nullptr_t);
+        Writer& Value(bool value);
+        Writer& Value(int value);
+        Writer& Value(double value);
+        Writer& Value(std::string_view value);
+        Writer& Value(const char* value) {
+            return Value(std::string_view(value));
+        }
+        Writer& Value(const std::string& value) {
+            return Value(std::string_view(value));
+        }
+        Writer& Value(const Node& value);
+        // Вставляет уже сериализованное значение как очередной элемент
+        Writer& RawValue(std::string_view json);
+
+        // Отдаёт накопленный текст в поток, не сбрасывая сам поток
+        void Flush();
+        std::string Release();
+
+    private:
+        struct Level {
+            bool is_dict;
+            bool first = true;
+        };
+
+        void BeforeValue();
+        void EndContainer(bool is_dict, char close);
+        void WriteIndent(size_t depth);
+        void WriteString(std::string_view value);
+        void MaybeFlush();
+
+        static constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+        static constexpr size_t INDENT_STEP = 4;
+
+        std::ostream* out_ = nullptr;
+        size_t base_depth_ = 0;
+        bool compact_ = false;
+        std::string buffer_;
+        std::vector<Level> stack_;
+        bool key_written_ = false;
+    };
+
+} // namespace json
@@ -0,0 +1,76 @@
+#include "label_placer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Средняя ширина символа Verdana в долях размера шрифта, с запасом на полужирный
+constexpr double CHAR_WIDTH = 0.62;
+// Части высоты шрифта выше и ниже базовой линии
+constexpr double ASCENT = 0.8;
+constexpr double DESCENT = 0.2;
+
+size_t CountCodePoints(std::string_view text) {
+    return std::count_if(text.begin(), text.end(), [](char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    });
+}
+
+}  // namespace
+
+double EstimateLabelWidth(double font_size, std::string_view text) {
+    return CountCodePoints(text) * CHAR_WIDTH * font_size;
+}
+
+LabelBox EstimateLabelBox(svg::Point position, svg::Point offset, double font_size,
+                          std::string_view text, double margin) {
+    const double left = position.x + offset.x;
+    const double baseline = position.y + offset.y;
+    const double width = EstimateLabelWidth(font_size, text);
+    return {left - margin, baseline - ASCENT * font_size - margin,
+            left + width + margin, baseline + DESCENT * font_size + margin};
+}
+
+LabelPlacer::LabelPlacer(double cell_size)
+    : cell_size_(cell_size > 0 ? cell_size : 1.0) {
+}
+
+int64_t LabelPlacer::Cell(double coordinate) const {
+    return static_cast<int64_t>(std::floor(coordinate / cell_size_));
+}
+
+uint64_t LabelPlacer::CellKey(int64_t column, int64_t row) {
+    return (static_cast<uint64_t>(column) << 32) ^ static_cast<uint32_t>(row);
+}
+
+bool LabelPlacer::IsFree(const LabelBox& box) const {
+    for (int64_t row = Cell(box.top); row <= Cell(box.bottom); ++row) {
+        for (int64_t column = Cell(box.left); column <= Cell(box.right); ++column) {
+            const auto it = cells_.find(CellKey(column, row));
+            if (it == cells_.end()) {
+                continue;
+            }
+            for (const uint32_t index : it->second) {
+                if (boxes_[index].Intersects(box)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool LabelPlacer::TryPlace(const LabelBox& box) {
+    if (!IsFree(box)) {
+        return false;
+    }
+    const auto index = static_cast<uint32_t>(boxes_.size());
+    boxes_.push_back(box);
+    for (int64_t row = Cell(box.top); row <= Cell(box.bottom); ++row) {
+        for (int64_t column = Cell(box.left); column <= Cell(box.right); ++column) {
+            cells_[CellKey(column, row)].push_back(index);
+        }
+    }
+    return true;
+}
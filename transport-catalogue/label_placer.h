@@ -0,0 +1,57 @@
+#pragma once
+
+#include "svg.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Прямоугольник в координатах изображения, y растёт вниз
+struct LabelBox {
+    double left = 0;
+    double top = 0;
+    double right = 0;
+    double bottom = 0;
+
+    bool Intersects(const LabelBox& other) const {
+        return left < other.right && other.left < right && top < other.bottom && other.top < bottom;
+    }
+};
+
+// Оценка ширины подписи без измерения шрифта: по числу символов UTF-8
+// и средней ширине символа
+double EstimateLabelWidth(double font_size, std::string_view text);
+
+// Прямоугольник подписи в точке position со смещением offset: ширина — по оценке
+// EstimateLabelWidth, высота — размер шрифта вокруг базовой линии.
+// margin добавляется со всех сторон (половина ширины подложки)
+LabelBox EstimateLabelBox(svg::Point position, svg::Point offset, double font_size,
+                          std::string_view text, double margin);
+
+// Занятые подписями прямоугольники в равномерной хеш-сетке. Проверка нового
+// прямоугольника смотрит только ячейки, которые он накрывает, поэтому расстановка
+// n подписей сопоставимого размера занимает время, близкое к линейному
+class LabelPlacer {
+public:
+    // cell_size — сторона ячейки; удобно брать в несколько высот подписи
+    explicit LabelPlacer(double cell_size);
+
+    bool IsFree(const LabelBox& box) const;
+    // Занимает box, если он ни с чем не пересекается
+    bool TryPlace(const LabelBox& box);
+
+    size_t Size() const {
+        return boxes_.size();
+    }
+
+private:
+    int64_t Cell(double coordinate) const;
+    static uint64_t CellKey(int64_t column, int64_t row);
+
+    double cell_size_;
+    std::vector<LabelBox> boxes_;
+    // Номера прямоугольников из boxes_, задевающих ячейку
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells_;
+};
@@ -1,18 +1,144 @@
 #include "json_reader.h"  
+#include "json_view.h"
 #include <iostream>
-#include <stdio.h>
+#include <string_view>
+
+#include "metrics.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "server.h"
+#include "thread_pool.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+using namespace std::literals;
+
+int main(int argc, char* argv[]) {
+    std::optional<std::string> input_path;
+    json::ParserKind parser = json::ParserKind::RECURSIVE;
+    size_t threads = 1;
+    bool serve = false;
+    bool ndjson = false;
+    std::string socket_path;
+    std::string client_socket_path;
+    std::string tile_cache_path;
+    std::string metrics_path;
+    std::string trace_path;
+    bool perf_counters = false;
+    std::optional<int> tiles_max_zoom;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--parser=index"sv) {
+            parser = json::ParserKind::STRUCTURAL_INDEX;
+        } else if (arg == "--parser=recursive"sv) {
+            parser = json::ParserKind::RECURSIVE;
+        } else if (arg.substr(0, 10) == "--threads="sv) {
+            threads = std::stoul(std::string(arg.substr(10)));
+        } else if (arg == "--serve"sv) {
+            serve = true;
+        } else if (arg == "--ndjson"sv) {
+            ndjson = true;
+        } else if (arg.substr(0, 9) == "--socket="sv) {
+            socket_path = arg.substr(9);
+        } else if (arg.substr(0, 9) == "--client="sv) {
+            client_socket_path = arg.substr(9);
+        } else if (arg.substr(0, 13) == "--tile-cache="sv) {
+            tile_cache_path = arg.substr(13);
+        } else if (arg.substr(0, 10) == "--metrics="sv) {
+            metrics_path = arg.substr(10);
+        } else if (arg == "--perf-counters"sv) {
+            perf_counters = true;
+        } else if (arg.substr(0, 8) == "--trace="sv) {
+            trace_path = arg.substr(8);
+        } else if (arg.substr(0, 8) == "--tiles="sv) {
+            tiles_max_zoom = std::stoi(std::string(arg.substr(8)));
+        } else {
+            input_path = arg;
+        }
+    }
+
+    if (!client_socket_path.empty()) {
+        return RunSocketClient(client_socket_path, std::cin, std::cout);
+    }
+
+    // Замеры печатаются при любом выходе из main: в std::cerr или в файл --metrics
+    const metrics::ExitDump metrics_dump(metrics_path);
+    // Трассировка в формате Chrome trace, только с --trace; файл пишется после остановки пула
+    const trace::Session trace_session(trace_path);
+
+    // Счётчики наследуются только потоками, созданными после открытия, поэтому до пула
+    if (perf_counters && !perf::Start()) {
+        std::cerr << "hardware counters are unavailable: "sv << perf::GetError() << std::endl;
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+
+    // Документ ссылается на отображённый файл, а не копирует из него строки
+    const auto load_input = [&] {
+        MEASURE_PHASE("json_parse");
+        return json::LoadFileView(input_path.value_or("text.txt"), parser, pool.get());
+    };
 
-#include "log_duration.h"
-int main() {
-    LOG_DURATION("CODE");
-    freopen("text.txt","r",stdin);
-    
-    
-    json::Document input_json = json::Load(std::cin);
     TransportCatalogue catalogue;
     RequestManager manager(catalogue);
+    if (!tile_cache_path.empty()) {
+        manager.SetTileCacheDirectory(tile_cache_path);
+    }
+
+    // Пакетный режим: заполнить кеш плиток по справочнику из файла и выйти
+    if (tiles_max_zoom) {
+        if (tile_cache_path.empty()) {
+            std::cerr << "--tiles requires --tile-cache=DIR"sv << std::endl;
+            return 1;
+        }
+        if (*tiles_max_zoom < 0 || *tiles_max_zoom > TileCache::MAX_GENERATE_ZOOM) {
+            std::cerr << "--tiles=Z requires 0 <= Z <= "sv << TileCache::MAX_GENERATE_ZOOM << std::endl;
+            return 1;
+        }
+        const json::ViewDocument base = load_input();
+        manager.LoadBase(base.GetRoot().AsMap());
+        MEASURE_PHASE("tiles_generate");
+        try {
+            const auto stats = manager.GenerateTiles(*tiles_max_zoom, pool.get());
+            std::cerr << "tiles: "sv << stats.rendered << " rendered, "sv << stats.cached << " cached"sv << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "tiles: "sv << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (serve || ndjson || !socket_path.empty()) {
+        Server server(manager, pool.get());
+        // Для сокета и построчного режима справочник берётся из файла,
+        // для пакетов из stdin — из первого пакета
+        if (input_path || ndjson || !socket_path.empty()) {
+            const json::ViewDocument base = load_input();
+            manager.LoadBase(base.GetRoot().AsMap());
+            // Резидентный процесс строит маршрутизатор заранее, чтобы не задерживать первый ответ
+            manager.PrepareRouter();
+        }
+        if (!socket_path.empty()) {
+            try {
+                server.ServeSocket(socket_path);
+            } catch (const std::runtime_error& e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        } else if (ndjson) {
+            server.ServeLines(std::cin, std::cout);
+        } else {
+            server.ServeStream(std::cin, std::cout);
+        }
+        return 0;
+    }
+    
+    const json::ViewDocument input_json = load_input();
     manager.ProcessInput(input_json.GetRoot());
-    json::Node responses = manager.GetResponses();
-    json::Document doc(responses);
-    json::Print(doc, std::cout);
-}
\ No newline at end of file
+    manager.WriteResponses(std::cout, pool.get());
+}
@@ -1,13 +1,150 @@
 #include "map_renderer.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <cmath>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// FNV-1a: быстрый и одинаковый на всех платформах
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+
+void HashBytes(uint64_t& hash, const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+}
+
+void HashString(uint64_t& hash, std::string_view value) {
+    HashBytes(hash, value.data(), value.size());
+    // Разделитель, чтобы "ab" + "c" и "a" + "bc" различались
+    HashBytes(hash, "", 1);
+}
+
+void HashDouble(uint64_t& hash, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    HashBytes(hash, &bits, sizeof(bits));
+}
+
+// Квадрат расстояния от точки до отрезка [a, b]
+double SegmentDistanceSquared(svg::Point point, svg::Point a, svg::Point b) {
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const double length_squared = dx * dx + dy * dy;
+    double t = 0;
+    if (length_squared > 0) {
+        t = std::clamp(((point.x - a.x) * dx + (point.y - a.y) * dy) / length_squared, 0.0, 1.0);
+    }
+    const double ex = point.x - (a.x + t * dx);
+    const double ey = point.y - (a.y + t * dy);
+    return ex * ex + ey * ey;
+}
+
+// Douglas–Peucker: оставляет вершины, без которых линия отклонилась бы больше
+// чем на tolerance. Концы сохраняются всегда. Работает по уже спроецированным
+// точкам, поэтому допуск задаётся в пикселях и на крупном масштабе (viewport,
+// плитки) упрощение само становится слабее
+std::vector<svg::Point> SimplifyLine(const std::vector<svg::Point>& points, double tolerance) {
+    if (tolerance <= 0 || points.size() < 3) {
+        return points;
+    }
+    const double tolerance_squared = tolerance * tolerance;
+    std::vector<bool> keep(points.size(), false);
+    keep.front() = keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> ranges{{0, points.size() - 1}};
+    while (!ranges.empty()) {
+        const auto [first, last] = ranges.back();
+        ranges.pop_back();
+        double max_distance = 0;
+        size_t farthest = first;
+        for (size_t i = first + 1; i < last; ++i) {
+            const double distance = SegmentDistanceSquared(points[i], points[first], points[last]);
+            if (distance > max_distance) {
+                max_distance = distance;
+                farthest = i;
+            }
+        }
+        if (max_distance > tolerance_squared) {
+            keep[farthest] = true;
+            ranges.push_back({first, farthest});
+            ranges.push_back({farthest, last});
+        }
+    }
+    std::vector<svg::Point> result;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (keep[i]) {
+            result.push_back(points[i]);
+        }
+    }
+    return result;
+}
+
+// Конечные, у которых подписывается маршрут: первая остановка и, для некольцевого
+// маршрута с разными концами, средняя. Вторая может быть nullptr
+std::array<const Stop*, 2> GetTerminals(const Bus& route) {
+    const Stop* last = route.stops[route.stops.size() / 2];
+    if (route.is_roundtrip || route.stops.front()->name == last->name) {
+        last = nullptr;
+    }
+    return {route.stops.front(), last};
+}
+
+// Число вариантов сдвига подписи в режиме SHIFT
+constexpr uint8_t LABEL_SHIFTS = 4;
+
+// Смещение подписи для варианта choice: 0 — заданное в настройках, 1 — зеркально
+// слева от точки, 2 и 3 — на строку выше и ниже
+svg::Point LabelShift(const LabelStyle& style, double width, uint8_t choice) {
+    switch (choice) {
+        case 1:
+            return {-style.offset.x - width, style.offset.y};
+        case 2:
+            return {style.offset.x, style.offset.y - style.font_size};
+        case 3:
+            return {style.offset.x, style.offset.y + style.font_size};
+        default:
+            return style.offset;
+    }
+}
+
+}  // namespace
 
 
 
 void RenderSettingsHandler::Parse(const json::Node& render_settings){
     const auto& settings_as_map = render_settings.AsMap();
+    colors_.clear();
     width_ = settings_as_map.at("width").AsDouble();
     height_ = settings_as_map.at("height").AsDouble();
     padding_ = settings_as_map.at("padding").AsDouble();
     routes_settings_.SetStrokeWidth(settings_as_map.at("line_width").AsDouble());
+    line_simplify_tolerance_ = 0;
+    if (const auto it = settings_as_map.find("line_simplify_tolerance"); it != settings_as_map.end()) {
+        line_simplify_tolerance_ = it->second.AsDouble();
+        if (line_simplify_tolerance_ < 0) {
+            throw std::invalid_argument("line_simplify_tolerance must not be negative");
+        }
+    }
+    compact_format_.reset();
+    if (const auto it = settings_as_map.find("compact_svg"); it != settings_as_map.end() && it->second.AsBool()) {
+        compact_format_.emplace();
+        if (const auto precision = settings_as_map.find("svg_precision"); precision != settings_as_map.end()) {
+            compact_format_->precision = precision->second.AsInt();
+            if (compact_format_->precision < 0 || compact_format_->precision > 6) {
+                throw std::invalid_argument("svg_precision must be in [0, 6]");
+            }
+        }
+    }
     stops_settings_.SetRadius(settings_as_map.at("stop_radius").AsDouble());
 
     names_for_bus_settings_.SetFontSize(settings_as_map.at("bus_label_font_size").AsInt());
@@ -45,6 +182,34 @@ void RenderSettingsHandler::Parse(const json::Node& render_settings){
         names_for_stop_settings_underlayer_.SetStrokeColor(underlayer_color);
         names_for_stop_settings_underlayer_.SetFillColor(underlayer_color);
     }
+    underlayer_width_ = settings_as_map.at("underlayer_width").AsDouble();
+    bus_label_style_ = {settings_as_map.at("bus_label_font_size").AsDouble(),
+                        {settings_as_map.at("bus_label_offset").AsArray()[0].AsDouble(),
+                         settings_as_map.at("bus_label_offset").AsArray()[1].AsDouble()}};
+    stop_label_style_ = {settings_as_map.at("stop_label_font_size").AsDouble(),
+                         {settings_as_map.at("stop_label_offset").AsArray()[0].AsDouble(),
+                          settings_as_map.at("stop_label_offset").AsArray()[1].AsDouble()}};
+    label_collision_ = LabelCollision::NONE;
+    if (const auto it = settings_as_map.find("label_collision"); it != settings_as_map.end()) {
+        const std::string& mode = it->second.AsString();
+        if (mode == "drop") {
+            label_collision_ = LabelCollision::DROP;
+        } else if (mode == "shift") {
+            label_collision_ = LabelCollision::SHIFT;
+        } else if (mode != "none") {
+            throw std::invalid_argument("label_collision must be \"none\", \"drop\" or \"shift\"");
+        }
+    }
+    stop_labels_first_ = false;
+    if (const auto it = settings_as_map.find("label_priority"); it != settings_as_map.end()) {
+        const json::Array& priority = it->second.AsArray();
+        if (priority.size() != 2 || priority[0].AsString() == priority[1].AsString()
+            || (priority[0].AsString() != "bus" && priority[0].AsString() != "stop")
+            || (priority[1].AsString() != "bus" && priority[1].AsString() != "stop")) {
+            throw std::invalid_argument("label_priority must be [\"bus\", \"stop\"] or [\"stop\", \"bus\"]");
+        }
+        stop_labels_first_ = priority[0].AsString() == "stop";
+    }
     names_for_bus_settings_underlayer_.SetStrokeWidth(settings_as_map.at("underlayer_width").AsDouble());
     names_for_stop_settings_underlayer_.SetStrokeWidth(settings_as_map.at("underlayer_width").AsDouble());
     for(const auto& color: settings_as_map.at("color_palette").AsArray()){
@@ -80,131 +245,702 @@ void RenderSettingsHandler::Parse(const json::Node& render_settings){
 
 void MapRenderer::FillMapRenderer(const json::Node& render_settings){
     rsh_.Parse(render_settings);
+    ++settings_version_;
+    json::Writer settings_text(size_t{0});
+    settings_text.Value(render_settings);
+    settings_hash_ = FNV_OFFSET;
+    HashString(settings_hash_, settings_text.Release());
+}
+
+void MapRenderer::DrawMap(std::ostream& out, ThreadPool* pool) {
+    TRACE_SCOPE("DrawMap");
+    PrepareLayers();
+    if (pool != nullptr) {
+        svg::Document::RenderBegin(out);
+        for (const std::string& part : RenderParts(*pool, false)) {
+            out << part;
+        }
+        svg::Document::RenderEnd(out);
+    } else if (rsh_.GetCompactFormat()) {
+        // Компактная карта всегда собирается из одних и тех же частей,
+        // чтобы имена классов не зависели от числа потоков
+        const std::vector<MapPart> parts = SplitIntoParts(COMPACT_PART_SIZE);
+        svg::Document::RenderBegin(out);
+        for (size_t index = 0; index < parts.size(); ++index) {
+            out << RenderPart(parts[index], index, false);
+        }
+        svg::Document::RenderEnd(out);
+    } else {
+        svg::Document drawing;
+        for (const Layer layer : LAYERS) {
+            DrawLayer(drawing, layer, 0, GetLayerSize(layer));
+        }
+        drawing.Render(out);
+    }
+}
+
+const std::string& MapRenderer::GetMapAsJsonString(ThreadPool* pool) {
+    const std::pair versions{tc_.GetVersion(), settings_version_};
+    if (rendered_versions_ == versions) {
+        metrics::Registry::Instance().Increment("map_cache_hits");
+        return map_json_;
+    }
+    MEASURE_PHASE("render");
+    map_json_.clear();
+    map_json_ += '"';
+    {
+        // SVG экранируется по мере вывода, неэкранированный текст целиком не хранится
+        json::EscapingStreamBuf buffer(map_json_);
+        std::ostream out(&buffer);
+        if (rsh_.GetCompactFormat()) {
+            // Классы компактного вывода общие для части карты, по элементам её не собрать
+            if (pool == nullptr) {
+                DrawMap(out, nullptr);
+            } else {
+                // Части экранируются в пуле, здесь только склеиваются
+                PrepareLayers();
+                std::vector<std::string> parts = RenderParts(*pool, true);
+                svg::Document::RenderBegin(out);
+                for (const std::string& part : parts) {
+                    map_json_ += part;
+                }
+                svg::Document::RenderEnd(out);
+            }
+        } else {
+            PrepareLayers();
+            UpdateFragments(pool);
+            size_t total_size = map_json_.size();
+            for (const auto& layer_fragments : fragments_) {
+                for (const Fragment& fragment : layer_fragments) {
+                    total_size += fragment.svg.size();
+                }
+            }
+            map_json_.reserve(total_size + 256);
+            svg::Document::RenderBegin(out);
+            for (const auto& layer_fragments : fragments_) {
+                for (const Fragment& fragment : layer_fragments) {
+                    map_json_ += fragment.svg;
+                }
+            }
+            svg::Document::RenderEnd(out);
+        }
+    }
+    map_json_ += '"';
+    rendered_versions_ = versions;
+    return map_json_;
+}
+
+void MapRenderer::DrawViewport(std::ostream& out, const MapViewport& viewport) {
+    MEASURE_PHASE("render");
+    PrepareSpatialIndex();
+    RenderViewport(out, viewport);
+}
+
+void MapRenderer::PrepareTiles() {
+    PrepareSpatialIndex();
+}
+
+bool MapRenderer::DrawTile(std::ostream& out, TileId tile) const {
+    if (!IsValidTile(tile)) {
+        return false;
+    }
+    const int tiles_per_side = 1 << tile.z;
+    // Квадрат со стороной в большую из сторон охвата, от северо-западного угла
+    const double side = std::max({network_box_.max_lat - network_box_.min_lat,
+                                  network_box_.max_lng - network_box_.min_lng, EPSILON});
+    const double tile_side = side / tiles_per_side;
+    MapViewport viewport;
+    viewport.box.min_lng = network_box_.min_lng + tile.x * tile_side;
+    viewport.box.max_lng = viewport.box.min_lng + tile_side;
+    viewport.box.max_lat = network_box_.max_lat - tile.y * tile_side;
+    viewport.box.min_lat = viewport.box.max_lat - tile_side;
+    viewport.width = TILE_SIZE;
+    viewport.height = TILE_SIZE;
+    viewport.padding = 0.0;
+    RenderViewport(out, viewport);
+    return true;
+}
+
+void MapRenderer::RenderViewport(std::ostream& out, const MapViewport& viewport) const {
+    const geo::Box& box = viewport.box;
+    const geo::Coordinates corners[] = {{box.min_lat, box.min_lng}, {box.max_lat, box.max_lng}};
+    const SphereProjector projector{std::begin(corners), std::end(corners),
+                                    viewport.width.value_or(rsh_.GetWidth()),
+                                    viewport.height.value_or(rsh_.GetHeight()),
+                                    viewport.padding.value_or(rsh_.GetPadding())};
+    const auto to_coordinates = [](const Stop* stop) {
+        return geo::Coordinates{stop->latitude, stop->longitude};
+    };
+
+    std::vector<size_t> visible_routes;
+    for (size_t index = 0; index < route_boxes_.size(); ++index) {
+        if (route_boxes_[index].Intersects(box)) {
+            visible_routes.push_back(index);
+        }
+    }
+    const std::vector<uint32_t> visible_stops = stop_index_.Query(box);
+
+    svg::Document drawing;
+    const std::vector<svg::Color> colors = rsh_.GetColorPalette();
+
+    // Линии: каждый непрерывный видимый участок маршрута — отдельная ломаная
+    const double tolerance = rsh_.GetLineSimplifyTolerance();
+    std::vector<svg::Point> piece;
+    for (const size_t index : visible_routes) {
+        const std::vector<const Stop*>& stops = sorted_routes_[index]->stops;
+        svg::Polyline route_line = rsh_.GetRoutesSettings();
+        route_line.SetStrokeColor(colors[index % colors.size()]);
+        piece.clear();
+        const auto finish_piece = [&] {
+            if (!piece.empty()) {
+                svg::Polyline line = route_line;
+                for (const svg::Point& point : SimplifyLine(piece, tolerance)) {
+                    line.AddPoint(point);
+                }
+                drawing.Add(line);
+                piece.clear();
+            }
+        };
+        if (stops.size() == 1 && box.Contains(to_coordinates(stops.front()))) {
+            piece.push_back(projector(to_coordinates(stops.front())));
+        }
+        for (size_t i = 0; i + 1 < stops.size(); ++i) {
+            geo::Coordinates from = to_coordinates(stops[i]);
+            geo::Coordinates to = to_coordinates(stops[i + 1]);
+            const geo::Coordinates segment_end = to;
+            if (!geo::ClipSegment(box, from, to)) {
+                finish_piece();
+                continue;
+            }
+            if (piece.empty()) {
+                piece.push_back(projector(from));
+            }
+            piece.push_back(projector(to));
+            // Отрезок вышел за границу: следующий видимый участок начнётся заново
+            if (to.lat != segment_end.lat || to.lng != segment_end.lng) {
+                finish_piece();
+            }
+        }
+        finish_piece();
+    }
+
+    // Подписи раскладываются заново для каждой части карты: на крупном масштабе
+    // места больше и скрывать приходится меньше
+    LabelChoices label_choices;
+    if (rsh_.GetLabelCollision() != LabelCollision::NONE) {
+        label_choices = PlaceLabels(visible_routes, std::vector<size_t>(visible_stops.begin(), visible_stops.end()),
+                                    [&](const Stop* stop) -> std::optional<svg::Point> {
+                                        if (!box.Contains(to_coordinates(stop))) {
+                                            return std::nullopt;
+                                        }
+                                        return projector(to_coordinates(stop));
+                                    });
+    }
+
+    // Названия маршрутов — у конечных остановок, попавших в прямоугольник
+    svg::Text buses_name = rsh_.GetBusNamesSettings();
+    svg::Text buses_name_underlayer = rsh_.GetBusNamesUnderlayerSettings();
+    const LabelStyle bus_style = rsh_.GetBusLabelStyle();
+    for (const size_t index : visible_routes) {
+        const Bus& route = *sorted_routes_[index];
+        buses_name.SetData(route.name);
+        buses_name_underlayer.SetData(route.name);
+        buses_name.SetFillColor(colors[index % colors.size()]);
+        const auto terminals = GetTerminals(route);
+        for (size_t i = 0; i < terminals.size(); ++i) {
+            const Stop* stop = terminals[i];
+            if (stop == nullptr || !box.Contains(to_coordinates(stop))
+                || !ApplyLabelChoice(label_choices.routes, 2 * index + i, bus_style, buses_name, buses_name_underlayer, route.name)) {
+                continue;
+            }
+            const svg::Point position = projector(to_coordinates(stop));
+            buses_name_underlayer.SetPosition(position);
+            buses_name.SetPosition(position);
+            drawing.Add(buses_name_underlayer);
+            drawing.Add(buses_name);
+        }
+    }
+
+    svg::Circle circle = rsh_.GetStopsSettings();
+    circle.SetFillColor("white");
+    for (const uint32_t index : visible_stops) {
+        circle.SetCenter(projector(to_coordinates(sorted_stops_[index])));
+        drawing.Add(circle);
+    }
+
+    svg::Text stops_name = rsh_.GetStopNamesSettings();
+    svg::Text stops_name_underlayer = rsh_.GetStopNameUnderlayerSetting();
+    const LabelStyle stop_style = rsh_.GetStopLabelStyle();
+    for (const uint32_t index : visible_stops) {
+        const Stop* stop = sorted_stops_[index];
+        if (!ApplyLabelChoice(label_choices.stops, index, stop_style, stops_name, stops_name_underlayer, stop->name)) {
+            continue;
+        }
+        const svg::Point position = projector(to_coordinates(stop));
+        stops_name_underlayer.SetData(stop->name);
+        stops_name_underlayer.SetPosition(position);
+        stops_name.SetData(stop->name);
+        stops_name.SetPosition(position);
+        drawing.Add(stops_name_underlayer);
+        drawing.Add(stops_name);
+    }
+
+    const auto& compact = rsh_.GetCompactFormat();
+    drawing.Render(out, compact ? &*compact : nullptr);
+}
+
+void MapRenderer::PrepareSpatialIndex() {
+    if (index_version_ == tc_.GetVersion()) {
+        return;
+    }
+    PrepareLayers();
+    std::vector<geo::Coordinates> stop_coords;
+    stop_coords.reserve(sorted_stops_.size());
+    for (const Stop* stop : sorted_stops_) {
+        stop_coords.push_back({stop->latitude, stop->longitude});
+    }
+    stop_index_ = geo::GridIndex(std::move(stop_coords));
+
+    route_boxes_.clear();
+    route_boxes_.reserve(sorted_routes_.size());
+    catalogue_hash_ = FNV_OFFSET;
+    network_box_ = {};
+    for (const Bus* route : sorted_routes_) {
+        const Stop* first = route->stops.front();
+        geo::Box route_box{first->latitude, first->longitude, first->latitude, first->longitude};
+        HashString(catalogue_hash_, route->name);
+        for (const Stop* stop : route->stops) {
+            route_box.Extend({stop->latitude, stop->longitude});
+            HashString(catalogue_hash_, stop->name);
+        }
+        HashBytes(catalogue_hash_, &route->is_roundtrip, sizeof(route->is_roundtrip));
+        if (route_boxes_.empty()) {
+            network_box_ = route_box;
+        } else {
+            network_box_.Extend({route_box.min_lat, route_box.min_lng});
+            network_box_.Extend({route_box.max_lat, route_box.max_lng});
+        }
+        route_boxes_.push_back(route_box);
+    }
+    for (const Stop* stop : sorted_stops_) {
+        HashString(catalogue_hash_, stop->name);
+        HashDouble(catalogue_hash_, stop->latitude);
+        HashDouble(catalogue_hash_, stop->longitude);
+    }
+    index_version_ = tc_.GetVersion();
+}
+
+void MapRenderer::PrepareLayers() {
+    TRACE_SCOPE("PrepareLayers");
+    sorted_routes_.clear();
+    for (const Bus& bus : tc_.GetRoutes()) {
+        if (!bus.stops.empty()) {
+            sorted_routes_.push_back(&bus);
+        }
+    }
+    std::sort(sorted_routes_.begin(), sorted_routes_.end(), [](const Bus* a, const Bus* b) {
+        return a->name < b->name;
+    });
+    sorted_stops_ = tc_.GetSortedStops();
+    // Справочник мог пополниться после загрузки настроек
     projected_coords_ = MakeSphereProjector();
+    ProjectStops();
+
+    label_choices_ = {};
+    if (rsh_.GetLabelCollision() != LabelCollision::NONE) {
+        std::vector<size_t> routes(sorted_routes_.size());
+        std::iota(routes.begin(), routes.end(), size_t{0});
+        std::vector<size_t> stops(sorted_stops_.size());
+        std::iota(stops.begin(), stops.end(), size_t{0});
+        label_choices_ = PlaceLabels(routes, stops, [this](const Stop* stop) {
+            return std::optional(GetProjectedPoint(stop));
+        });
+    }
 }
-void MapRenderer::DrawMap(std::ostream& out) {
-    DrawLines();
-    DrawRoutesNames();
-    DrawStopsCircles();
-    DrawStopsNames();
-    final_drawing_.Render(out);
+
+bool MapRenderer::ApplyLabelChoice(const std::vector<uint8_t>& choices, size_t index, const LabelStyle& style,
+                                   svg::Text& text, svg::Text& underlayer, std::string_view data) {
+    if (choices.empty()) {
+        return true;
+    }
+    const uint8_t choice = choices[index];
+    if (choice == LABEL_HIDDEN) {
+        return false;
+    }
+    const double width = choice == 0 ? 0.0 : EstimateLabelWidth(style.font_size, data);
+    const svg::Point offset = LabelShift(style, width, choice);
+    text.SetOffset(offset);
+    underlayer.SetOffset(offset);
+    return true;
 }
 
-SphereProjector MapRenderer::MakeSphereProjector() const{
-    std::vector<geo::Coordinates> stops_coords;
-    for(const auto& bus: tc_.GetSortedRoutes()){
-        for(const auto& stop: bus.stops){
-            stops_coords.push_back({stop->latitude, stop->longitude});
-        }   
+MapRenderer::LabelChoices MapRenderer::PlaceLabels(const std::vector<size_t>& routes, const std::vector<size_t>& stops,
+                                                   const LabelPosition& position) const {
+    // Ячейка в несколько высот подписи: короткая подпись задевает одну-две ячейки
+    static constexpr double CELL_FONT_SIZES = 3;
+
+    const LabelStyle bus_style = rsh_.GetBusLabelStyle();
+    const LabelStyle stop_style = rsh_.GetStopLabelStyle();
+    const double margin = rsh_.GetUnderlayerWidth() / 2;
+    const uint8_t shifts = rsh_.GetLabelCollision() == LabelCollision::SHIFT ? LABEL_SHIFTS : 1;
+    LabelPlacer placer(CELL_FONT_SIZES * std::max(bus_style.font_size, stop_style.font_size));
+    const auto place = [&](svg::Point point, const LabelStyle& style, std::string_view text) {
+        const double width = EstimateLabelWidth(style.font_size, text);
+        for (uint8_t choice = 0; choice < shifts; ++choice) {
+            const svg::Point offset = LabelShift(style, width, choice);
+            if (placer.TryPlace(EstimateLabelBox(point, offset, style.font_size, text, margin))) {
+                return choice;
+            }
+        }
+        return LABEL_HIDDEN;
+    };
+
+    LabelChoices choices;
+    choices.routes.assign(2 * sorted_routes_.size(), LABEL_HIDDEN);
+    choices.stops.assign(sorted_stops_.size(), LABEL_HIDDEN);
+    const auto place_routes = [&] {
+        for (const size_t index : routes) {
+            const Bus& route = *sorted_routes_[index];
+            const auto terminals = GetTerminals(route);
+            for (size_t i = 0; i < terminals.size(); ++i) {
+                if (terminals[i] == nullptr) {
+                    continue;
+                }
+                if (const auto point = position(terminals[i])) {
+                    choices.routes[2 * index + i] = place(*point, bus_style, route.name);
+                }
+            }
+        }
+    };
+    const auto place_stops = [&] {
+        // Пересадочные остановки подписываются раньше: через них идёт больше маршрутов
+        std::vector<std::pair<size_t, size_t>> order;
+        order.reserve(stops.size());
+        for (const size_t index : stops) {
+            const auto* buses = tc_.GetBusesForStop(*sorted_stops_[index]);
+            order.push_back({buses ? buses->size() : 0, index});
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first > rhs.first;
+        });
+        for (const auto& [buses_count, index] : order) {
+            const Stop* stop = sorted_stops_[index];
+            if (const auto point = position(stop)) {
+                choices.stops[index] = place(*point, stop_style, stop->name);
+            }
+        }
+    };
+    if (rsh_.AreStopLabelsFirst()) {
+        place_stops();
+        place_routes();
+    } else {
+        place_routes();
+        place_stops();
     }
-    return SphereProjector{stops_coords.begin(), stops_coords.end(), rsh_.GetWidth(), rsh_.GetHeight(), rsh_.GetPadding()};
+    return choices;
 }
 
-std::vector<geo::Coordinates> MapRenderer::GetUpdatedCoords(std::vector<const Stop*> stops, SphereProjector proj) const{
-    std::vector<geo::Coordinates> temp;
-    for(const Stop* stop: stops){
-        temp.push_back({stop->latitude, stop->longitude});
+void MapRenderer::ProjectStops() {
+    const std::deque<Stop>& stops = tc_.GetStops();
+    const size_t block = SphereProjector::PROJECT_BLOCK;
+    const size_t padded_size = (stops.size() + block - 1) / block * block;
+    stop_latitudes_.assign(padded_size, 0.0);
+    stop_longitudes_.assign(padded_size, 0.0);
+    for (const Stop& stop : stops) {
+        stop_latitudes_[stop.id] = stop.latitude;
+        stop_longitudes_[stop.id] = stop.longitude;
     }
-    std::vector<geo::Coordinates> result;
-    for(const auto coord: temp){
-        result.push_back({proj(coord).x, proj(coord).y});
+    stop_xs_.resize(padded_size);
+    stop_ys_.resize(padded_size);
+    projected_coords_.Project(stop_latitudes_.data(), stop_longitudes_.data(), padded_size,
+                              stop_xs_.data(), stop_ys_.data());
+}
+
+std::vector<MapRenderer::MapPart> MapRenderer::SplitIntoParts(size_t part_size) const {
+    std::vector<MapPart> parts;
+    for (const Layer layer : LAYERS) {
+        const size_t layer_size = GetLayerSize(layer);
+        for (size_t begin = 0; begin < layer_size; begin += part_size) {
+            parts.push_back({layer, begin, std::min(layer_size, begin + part_size)});
+        }
+    }
+    return parts;
+}
+
+std::string MapRenderer::RenderPart(const MapPart& part, size_t index, bool escape) const {
+    svg::Document drawing;
+    DrawLayer(drawing, part.layer, part.begin, part.end);
+    std::optional<svg::CompactFormat> compact = rsh_.GetCompactFormat();
+    if (compact) {
+        compact->class_prefix += std::to_string(index);
+        compact->class_prefix += '_';
+    }
+    const svg::CompactFormat* format = compact ? &*compact : nullptr;
+    std::string result;
+    if (escape) {
+        json::EscapingStreamBuf buffer(result);
+        std::ostream out(&buffer);
+        drawing.RenderContent(out, format);
+    } else {
+        std::ostringstream out;
+        drawing.RenderContent(out, format);
+        result = out.str();
     }
     return result;
 }
-void MapRenderer::DrawLines(){
-    svg::Document doc;
-    const auto sorted_routes = tc_.GetSortedRoutes();
+
+std::vector<std::string> MapRenderer::RenderParts(ThreadPool& pool, bool escape) const {
+    static constexpr size_t PARTS_PER_THREAD = 4;
+    static constexpr size_t MIN_PART_SIZE = 256;
+
+    // Каждый слой режется на отрезки элементов; отрезок рисуется и сериализуется
+    // в свою строку независимо от остальных, порядок строк совпадает с порядком вывода
+    size_t part_size = COMPACT_PART_SIZE;
+    if (!rsh_.GetCompactFormat()) {
+        size_t total_size = 0;
+        for (const Layer layer : LAYERS) {
+            total_size += GetLayerSize(layer);
+        }
+        part_size = std::max(MIN_PART_SIZE, total_size / (pool.Size() * PARTS_PER_THREAD) + 1);
+    }
+
+    const std::vector<MapPart> parts = SplitIntoParts(part_size);
+    std::vector<std::future<std::string>> futures;
+    futures.reserve(parts.size());
+    for (size_t index = 0; index < parts.size(); ++index) {
+        futures.push_back(pool.Submit([this, &parts, index, escape] {
+            return RenderPart(parts[index], index, escape);
+        }));
+    }
+
+    // Задачи читают parts, поэтому выходить раньше, чем закончатся все, нельзя
+    return GetAll(futures);
+}
+
+void MapRenderer::UpdateFragments(ThreadPool* pool) {
+    TRACE_SCOPE("UpdateFragments");
+    static constexpr size_t FRAGMENTS_PER_TASK = 256;
+
+    const std::pair basis{projected_coords_, settings_version_};
+    if (fragments_basis_ != basis) {
+        for (auto& layer_fragments : fragments_) {
+            layer_fragments.clear();
+        }
+        fragments_basis_ = basis;
+    }
+
+    const size_t colors_count = rsh_.GetColorPalette().size();
+    const auto key_of = [&](Layer layer, size_t index) -> Fragment {
+        switch (layer) {
+            case Layer::ROUTE_LINES:
+                return {sorted_routes_[index], index % colors_count, 0, {}};
+            case Layer::ROUTE_NAMES: {
+                uint32_t labels = 0;
+                if (!label_choices_.routes.empty()) {
+                    labels = label_choices_.routes[2 * index] | (label_choices_.routes[2 * index + 1] << 8);
+                }
+                return {sorted_routes_[index], index % colors_count, labels, {}};
+            }
+            case Layer::STOP_CIRCLES:
+                return {sorted_stops_[index], 0, 0, {}};
+            case Layer::STOP_NAMES:
+                return {sorted_stops_[index], 0, label_choices_.stops.empty() ? 0u : label_choices_.stops[index], {}};
+        }
+        return {};
+    };
+
+    // Фрагменты, которых нет среди прежних: номер слоя и номер элемента
+    std::vector<std::pair<size_t, size_t>> missing;
+    for (size_t layer_index = 0; layer_index < std::size(LAYERS); ++layer_index) {
+        const Layer layer = LAYERS[layer_index];
+        std::vector<Fragment> old_fragments = std::move(fragments_[layer_index]);
+        std::unordered_map<const void*, size_t> old_positions;
+        old_positions.reserve(old_fragments.size());
+        for (size_t i = 0; i < old_fragments.size(); ++i) {
+            old_positions.emplace(old_fragments[i].object, i);
+        }
+        std::vector<Fragment>& fragments = fragments_[layer_index];
+        fragments.clear();
+        fragments.reserve(GetLayerSize(layer));
+        for (size_t index = 0; index < GetLayerSize(layer); ++index) {
+            Fragment key = key_of(layer, index);
+            const auto it = old_positions.find(key.object);
+            if (it != old_positions.end() && old_fragments[it->second].color == key.color
+                && old_fragments[it->second].labels == key.labels) {
+                fragments.push_back(std::move(old_fragments[it->second]));
+            } else {
+                fragments.push_back(std::move(key));
+                missing.push_back({layer_index, index});
+            }
+        }
+    }
+
+    std::vector<std::future<void>> futures;
+    try {
+        if (pool == nullptr || missing.size() <= FRAGMENTS_PER_TASK) {
+            RenderFragments(missing, 0, missing.size());
+            return;
+        }
+        // Каждая задача пишет только в свои элементы fragments_
+        for (size_t begin = 0; begin < missing.size(); begin += FRAGMENTS_PER_TASK) {
+            const size_t end = std::min(missing.size(), begin + FRAGMENTS_PER_TASK);
+            futures.push_back(pool->Submit([this, &missing, begin, end] {
+                RenderFragments(missing, begin, end);
+            }));
+        }
+        GetAll(futures);
+    } catch (...) {
+        // Задачи читают missing; часть фрагментов осталась без текста,
+        // поэтому при следующем вызове всё рисуется заново
+        WaitAll(futures);
+        for (auto& layer_fragments : fragments_) {
+            layer_fragments.clear();
+        }
+        throw;
+    }
+}
+
+void MapRenderer::RenderFragments(const std::vector<std::pair<size_t, size_t>>& missing, size_t begin, size_t end) {
+    // Все фрагменты рисуются в один документ, затем он режется по границам элементов
+    svg::Document drawing;
+    std::vector<size_t> bounds{0};
+    bounds.reserve(end - begin + 1);
+    for (size_t i = begin; i < end; ++i) {
+        const auto [layer_index, index] = missing[i];
+        DrawLayer(drawing, LAYERS[layer_index], index, index + 1);
+        bounds.push_back(drawing.GetSize());
+    }
+    std::string fragment;
+    for (size_t i = begin; i < end; ++i) {
+        const auto [layer_index, index] = missing[i];
+        fragment.clear();
+        drawing.AppendContent(fragment, bounds[i - begin], bounds[i - begin + 1]);
+        std::string& svg = fragments_[layer_index][index].svg;
+        svg.clear();
+        json::AppendEscaped(svg, fragment);
+    }
+}
+
+size_t MapRenderer::GetLayerSize(Layer layer) const {
+    switch (layer) {
+        case Layer::ROUTE_LINES:
+        case Layer::ROUTE_NAMES:
+            return sorted_routes_.size();
+        case Layer::STOP_CIRCLES:
+        case Layer::STOP_NAMES:
+            return sorted_stops_.size();
+    }
+    return 0;
+}
+
+void MapRenderer::DrawLayer(svg::Document& doc, Layer layer, size_t begin, size_t end) const {
+    switch (layer) {
+        case Layer::ROUTE_LINES:
+            DrawLines(doc, begin, end);
+            break;
+        case Layer::ROUTE_NAMES:
+            DrawRoutesNames(doc, begin, end);
+            break;
+        case Layer::STOP_CIRCLES:
+            DrawStopsCircles(doc, begin, end);
+            break;
+        case Layer::STOP_NAMES:
+            DrawStopsNames(doc, begin, end);
+            break;
+    }
+}
+
+SphereProjector MapRenderer::MakeSphereProjector() const{
+    // Охват тот же, что у всех остановок всех маршрутов: в sorted_stops_ каждая по разу
+    std::vector<geo::Coordinates> stops_coords;
+    stops_coords.reserve(sorted_stops_.size());
+    for(const Stop* stop: sorted_stops_){
+        stops_coords.push_back({stop->latitude, stop->longitude});
+    }
+    return SphereProjector{stops_coords.begin(), stops_coords.end(), rsh_.GetWidth(), rsh_.GetHeight(), rsh_.GetPadding()};
+}
+
+// Номер маршрута в sorted_routes_ задаёт его цвет в палитре
+void MapRenderer::DrawLines(svg::Document& doc, size_t begin, size_t end) const{
     std::vector<svg::Color> colors = rsh_.GetColorPalette();
-    size_t index = 0;
-    for(const auto& route: sorted_routes){
-        if(route.stops.empty()){
-            continue;
+    const double tolerance = rsh_.GetLineSimplifyTolerance();
+    std::vector<svg::Point> points;
+    for(size_t index = begin; index < end; ++index){
+        const Bus& route = *sorted_routes_[index];
+        points.clear();
+        for (const Stop* stop : route.stops) {
+            points.push_back(GetProjectedPoint(stop));
         }
-        std::vector<geo::Coordinates> updated_route_coords = GetUpdatedCoords(route.stops, projected_coords_);
         //Отрисовка линий
         svg::Polyline route_line = rsh_.GetRoutesSettings();
         svg::Color color = colors[index%colors.size()];
         route_line.SetStrokeColor(color);
-        for (size_t i = 0; i < updated_route_coords.size(); i++)
-        {
-            route_line.AddPoint({updated_route_coords[i].lat, updated_route_coords[i].lng});
-
+        for (const svg::Point& point : SimplifyLine(points, tolerance)) {
+            route_line.AddPoint(point);
         }
-        final_drawing_.Add(route_line);
-        index++;
+        doc.Add(route_line);
     }
-    
-    
 }
 
-void MapRenderer::DrawRoutesNames(){
+void MapRenderer::DrawRoutesNames(svg::Document& doc, size_t begin, size_t end) const{
     svg::Text buses_name, buses_name_underlayer;
     buses_name = rsh_.GetBusNamesSettings();
     buses_name_underlayer = rsh_.GetBusNamesUnderlayerSettings();
+    const LabelStyle bus_style = rsh_.GetBusLabelStyle();
     std::vector<svg::Color> colors = rsh_.GetColorPalette();
-    size_t index = 0;
-    for(const auto& route: tc_.GetSortedRoutes()){
-        if(route.stops.empty()){
-            continue;
-        }
-        
+    for(size_t index = begin; index < end; ++index){
+        const Bus& route = *sorted_routes_[index];
         buses_name.SetData(route.name);
         buses_name_underlayer.SetData(route.name);
         svg::Color color = colors[index%colors.size()];
         buses_name.SetFillColor(color);
         
-        std::vector<geo::Coordinates> updated_coords = GetUpdatedCoords(route.stops, projected_coords_);
-        if(route.is_roundtrip || (route.stops[0]->name == route.stops[route.stops.size()/2]->name)){
-            buses_name_underlayer.SetPosition({updated_coords[0].lat, updated_coords[0].lng});
-            buses_name.SetPosition({updated_coords[0].lat, updated_coords[0].lng});
-            final_drawing_.Add(buses_name_underlayer);
-            final_drawing_.Add(buses_name);   
-        }
-
-        else{
-            const auto q = updated_coords[updated_coords.size()/2];
-            buses_name_underlayer.SetPosition({updated_coords.front().lat, updated_coords.front().lng});
-            buses_name.SetPosition({updated_coords.front().lat, updated_coords.front().lng});
-            final_drawing_.Add(buses_name_underlayer);
-            final_drawing_.Add(buses_name);
-            buses_name_underlayer.SetPosition({q.lat, q.lng});
-            buses_name.SetPosition({q.lat, q.lng});
-            final_drawing_.Add(buses_name_underlayer);
-            final_drawing_.Add(buses_name);
-        }
-        index++;
+        const auto terminals = GetTerminals(route);
+        for (size_t i = 0; i < terminals.size(); ++i) {
+            if (terminals[i] == nullptr
+                || !ApplyLabelChoice(label_choices_.routes, 2 * index + i, bus_style, buses_name, buses_name_underlayer, route.name)) {
+                continue;
+            }
+            const svg::Point position = GetProjectedPoint(terminals[i]);
+            buses_name_underlayer.SetPosition(position);
+            buses_name.SetPosition(position);
+            doc.Add(buses_name_underlayer);
+            doc.Add(buses_name);
+        }
     }
     
 }
-void MapRenderer::DrawStopsCircles(){
+void MapRenderer::DrawStopsCircles(svg::Document& doc, size_t begin, size_t end) const{
     svg::Circle circle = rsh_.GetStopsSettings();
     circle.SetFillColor("white");
-    std::vector<geo::Coordinates> updated_coords = GetUpdatedCoords(tc_.GetSortedStops(), projected_coords_);
-    for(const auto updated_coord: updated_coords){
-        circle.SetCenter({updated_coord.lat, updated_coord.lng});
-        final_drawing_.Add(circle);
+    for(size_t i = begin; i < end; ++i){
+        const Stop* stop = sorted_stops_[i];
+        circle.SetCenter(GetProjectedPoint(stop));
+        doc.Add(circle);
     }
 }
 
-void MapRenderer::DrawStopsNames(){
+void MapRenderer::DrawStopsNames(svg::Document& doc, size_t begin, size_t end) const{
     svg::Text stops_name, stops_name_underlayer;
     stops_name = rsh_.GetStopNamesSettings();
     stops_name_underlayer = rsh_.GetStopNameUnderlayerSetting();
-    const auto sorted_stops = tc_.GetSortedStops();
-    std::vector<geo::Coordinates> updated_coords = GetUpdatedCoords(sorted_stops, projected_coords_);
-    for (size_t i = 0; i < updated_coords.size(); i++)
+    const LabelStyle stop_style = rsh_.GetStopLabelStyle();
+    for (size_t i = begin; i < end; i++)
     {
-        stops_name_underlayer.SetData(sorted_stops[i]->name);
-        stops_name_underlayer.SetPosition({updated_coords[i].lat, updated_coords[i].lng});
-        stops_name.SetData(sorted_stops[i]->name);
-        stops_name.SetPosition({updated_coords[i].lat, updated_coords[i].lng});
+        const Stop* stop = sorted_stops_[i];
+        if (!ApplyLabelChoice(label_choices_.stops, i, stop_style, stops_name, stops_name_underlayer, stop->name)) {
+            continue;
+        }
+        const svg::Point position = GetProjectedPoint(stop);
+        stops_name_underlayer.SetData(stop->name);
+        stops_name_underlayer.SetPosition(position);
+        stops_name.SetData(stop->name);
+        stops_name.SetPosition(position);
         
-        final_drawing_.Add(stops_name_underlayer);
-        final_drawing_.Add(stops_name);
+        doc.Add(stops_name_underlayer);
+        doc.Add(stops_name);
         
     }
     
 
 }
-
-
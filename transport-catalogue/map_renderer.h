@@ -1,18 +1,38 @@
 #pragma once
 #include "geo.h"
 #include "json.h"
+#include "label_placer.h"
+#include "spatial_index.h"
 #include "svg.h"
 #include "transport_catalogue.h"
 
 #include <algorithm>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 #include <map>
 
 
+// Что делать с подписями, которые накладываются на уже размещённые
+enum class LabelCollision {
+    // Размещать все, как есть
+    NONE,
+    // Не выводить
+    DROP,
+    // Попробовать сдвинуть в сторону, не вышло — не выводить
+    SHIFT
+};
 
+// Размеры подписей одного вида, нужные для оценки их прямоугольников
+struct LabelStyle {
+    double font_size = 0;
+    svg::Point offset;
+};
 
 class RenderSettingsHandler{
 public:
@@ -48,6 +68,30 @@ public:
     double GetPadding() const{
         return padding_;
     }
+    // Допуск упрощения линий маршрутов в пикселях; 0 — линии не упрощаются
+    double GetLineSimplifyTolerance() const{
+        return line_simplify_tolerance_;
+    }
+    LabelCollision GetLabelCollision() const{
+        return label_collision_;
+    }
+    // Подписи остановок размещаются раньше подписей маршрутов и вытесняют их
+    bool AreStopLabelsFirst() const{
+        return stop_labels_first_;
+    }
+    LabelStyle GetBusLabelStyle() const{
+        return bus_label_style_;
+    }
+    LabelStyle GetStopLabelStyle() const{
+        return stop_label_style_;
+    }
+    double GetUnderlayerWidth() const{
+        return underlayer_width_;
+    }
+    // Задан, если в настройках включён компактный вывод SVG
+    const std::optional<svg::CompactFormat>& GetCompactFormat() const{
+        return compact_format_;
+    }
 private:
     svg::Circle stops_settings_;
     svg::Polyline routes_settings_;
@@ -59,6 +103,13 @@ private:
     double height_;
     double width_;
     double padding_;
+    double line_simplify_tolerance_ = 0;
+    std::optional<svg::CompactFormat> compact_format_;
+    LabelCollision label_collision_ = LabelCollision::NONE;
+    bool stop_labels_first_ = false;
+    LabelStyle bus_label_style_;
+    LabelStyle stop_label_style_;
+    double underlayer_width_ = 0;
 };
 
 
@@ -132,31 +183,206 @@ public:
         };
     }
 
+    // Массивы для Project дополняются до кратного PROJECT_BLOCK размера
+    static constexpr size_t PROJECT_BLOCK = 4;
+
+    // Проецирует count точек, заданных массивами широт и долгот, в массивы x и y.
+    // Расчёт тот же, что у operator(). Точки блока независимы и записаны подряд,
+    // поэтому компилятор объединяет их в векторные операции уже при -O2.
+    // count кратно PROJECT_BLOCK, массивы не перекрываются
+    void Project(const double* __restrict latitudes, const double* __restrict longitudes, size_t count,
+                 double* __restrict xs, double* __restrict ys) const {
+        const double min_lon = min_lon_;
+        const double max_lat = max_lat_;
+        const double zoom_coeff = zoom_coeff_;
+        const double padding = padding_;
+        for (size_t i = 0; i < count; i += PROJECT_BLOCK) {
+            xs[i] = (longitudes[i] - min_lon) * zoom_coeff + padding;
+            xs[i + 1] = (longitudes[i + 1] - min_lon) * zoom_coeff + padding;
+            xs[i + 2] = (longitudes[i + 2] - min_lon) * zoom_coeff + padding;
+            xs[i + 3] = (longitudes[i + 3] - min_lon) * zoom_coeff + padding;
+            ys[i] = (max_lat - latitudes[i]) * zoom_coeff + padding;
+            ys[i + 1] = (max_lat - latitudes[i + 1]) * zoom_coeff + padding;
+            ys[i + 2] = (max_lat - latitudes[i + 2]) * zoom_coeff + padding;
+            ys[i + 3] = (max_lat - latitudes[i + 3]) * zoom_coeff + padding;
+        }
+    }
+
+    // Проекции с равными параметрами переводят точки одинаково
+    bool operator==(const SphereProjector& other) const {
+        return padding_ == other.padding_ && min_lon_ == other.min_lon_
+            && max_lat_ == other.max_lat_ && zoom_coeff_ == other.zoom_coeff_;
+    }
+
 private:
-    double padding_;
+    double padding_ = 0;
     double min_lon_ = 0;
     double max_lat_ = 0;
     double zoom_coeff_ = 0;
 };
 
+class ThreadPool;
+
+// Часть карты: прямоугольник в координатах и, если заданы, свои размеры изображения
+// вместо width и height из render_settings
+struct MapViewport {
+    geo::Box box;
+    std::optional<double> width;
+    std::optional<double> height;
+    std::optional<double> padding;
+};
+
+// Плитка карты в схеме XYZ: квадрат, охватывающий всю сеть, на уровне z
+// делится на 2^z × 2^z плиток; x растёт на восток, y — на юг
+struct TileId {
+    int z = 0;
+    int x = 0;
+    int y = 0;
+};
+
 class MapRenderer{
 public:
     MapRenderer(TransportCatalogue& catalogue):tc_(catalogue){}
     void FillMapRenderer(const json::Node& render_settings);
-    void DrawMap(std::ostream& out);
+    // С пулом потоков слои карты рисуются по частям параллельно;
+    // результат совпадает с однопоточной отрисовкой байт в байт.
+    // Вызывать не из потока самого пула: части ожидаются через future
+    void DrawMap(std::ostream& out, ThreadPool* pool = nullptr);
+    // Карта в виде готового строкового значения JSON (в кавычках, экранированная)
+    // для json::Writer::RawValue. Отрисовка выполняется только при первом обращении
+    // после изменения справочника или настроек, иначе отдаётся сохранённый результат
+    const std::string& GetMapAsJsonString(ThreadPool* pool = nullptr);
+    // Рисует только то, что попадает в viewport.box: остановки внутри него и участки
+    // маршрутов, обрезанные по его границе. Цвета маршрутов те же, что на полной карте
+    void DrawViewport(std::ostream& out, const MapViewport& viewport);
+
+    static constexpr int TILE_SIZE = 256;
+    static constexpr int MAX_TILE_ZOOM = 20;
+    // Готовит индекс для плиток. После этого DrawTile и GetContentHash можно вызывать
+    // из нескольких потоков, пока не изменятся справочник или настройки
+    void PrepareTiles();
+    static bool IsValidTile(TileId tile) {
+        return tile.z >= 0 && tile.z <= MAX_TILE_ZOOM && tile.x >= 0 && tile.y >= 0
+            && tile.x < (1 << tile.z) && tile.y < (1 << tile.z);
+    }
+    // Рисует плитку TILE_SIZE × TILE_SIZE без полей. false — такой плитки нет
+    bool DrawTile(std::ostream& out, TileId tile) const;
+    // Хеш содержимого карты: остановок, маршрутов и настроек отрисовки.
+    // В отличие от версий, совпадает у разных процессов с одинаковыми данными
+    uint64_t GetContentHash() const {
+        return catalogue_hash_ ^ (settings_hash_ * 0x9E3779B97F4A7C15ull);
+    }
 
 private:
-    void DrawLines();
-    void DrawRoutesNames();
-    void DrawStopsCircles();
-    void DrawStopsNames(); 
+    // Слои в порядке вывода
+    enum class Layer {
+        ROUTE_LINES,
+        ROUTE_NAMES,
+        STOP_CIRCLES,
+        STOP_NAMES
+    };
+    static constexpr Layer LAYERS[] = {Layer::ROUTE_LINES, Layer::ROUTE_NAMES,
+                                       Layer::STOP_CIRCLES, Layer::STOP_NAMES};
+    // Размер части компактной карты; не зависит от пула, см. DrawMap
+    static constexpr size_t COMPACT_PART_SIZE = 1024;
+
+    // Экранированный для JSON SVG одного элемента слоя: линии или подписи маршрута,
+    // кружка или названия остановки. Объекты справочника не меняются после добавления,
+    // поэтому пока те же проекция и настройки, фрагмент определяется объектом
+    // и номером цвета в палитре (у остановок — 0)
+    struct Fragment {
+        const void* object;
+        size_t color;
+        // Выбранные места подписей (см. LabelChoices), у остальных слоёв — 0
+        uint32_t labels;
+        std::string svg;
+    };
+
+    // Место подписи при раскладке без наложений: номер сдвига для LabelShift
+    // или LABEL_HIDDEN, если подпись не поместилась
+    static constexpr uint8_t LABEL_HIDDEN = 0xFF;
+    struct LabelChoices {
+        // Для маршрута с номером i в sorted_routes_ — элементы 2i и 2i + 1 (первая
+        // и вторая конечная), для остановки — её номер в sorted_stops_.
+        // Пусто, если раскладка выключена
+        std::vector<uint8_t> routes;
+        std::vector<uint8_t> stops;
+    };
+    // Ставит подписи и её подложке смещение из раскладки. false — подпись скрыта.
+    // choices пуст, если раскладка выключена: тогда подпись не меняется
+    static bool ApplyLabelChoice(const std::vector<uint8_t>& choices, size_t index, const LabelStyle& style,
+                                 svg::Text& text, svg::Text& underlayer, std::string_view data);
+    // Положение точки привязки подписи остановки; nullopt — подпись не выводится
+    using LabelPosition = std::function<std::optional<svg::Point>(const Stop*)>;
+
+    // Отрезок [begin, end) элементов слоя, рисуемый отдельным документом
+    struct MapPart {
+        Layer layer;
+        size_t begin;
+        size_t end;
+    };
+
+    void PrepareLayers();
+    void PrepareSpatialIndex();
+    void RenderViewport(std::ostream& out, const MapViewport& viewport) const;
+    std::vector<MapPart> SplitIntoParts(size_t part_size) const;
+    // index — номер части в карте, из него строятся имена классов компактного вывода
+    std::string RenderPart(const MapPart& part, size_t index, bool escape) const;
+    std::vector<std::string> RenderParts(ThreadPool& pool, bool escape) const;
+    // Приводит fragments_ к текущему справочнику: прежние фрагменты переиспользуются,
+    // рисуются только новые и те, у кого сменился цвет. Если изменились проекция
+    // или настройки, все фрагменты рисуются заново
+    void UpdateFragments(ThreadPool* pool);
+    // Рисует фрагменты с номерами из missing[begin, end): пары (номер слоя, номер элемента)
+    void RenderFragments(const std::vector<std::pair<size_t, size_t>>& missing, size_t begin, size_t end);
+    size_t GetLayerSize(Layer layer) const;
+    // Рисует элементы слоя с номерами [begin, end)
+    void DrawLayer(svg::Document& doc, Layer layer, size_t begin, size_t end) const;
+    void DrawLines(svg::Document& doc, size_t begin, size_t end) const;
+    void DrawRoutesNames(svg::Document& doc, size_t begin, size_t end) const;
+    void DrawStopsCircles(svg::Document& doc, size_t begin, size_t end) const;
+    void DrawStopsNames(svg::Document& doc, size_t begin, size_t end) const;
+    // Раскладывает подписи маршрутов и остановок с данными номерами по порядку
+    // приоритета, пропуская или сдвигая те, что легли бы на уже размещённые
+    LabelChoices PlaceLabels(const std::vector<size_t>& routes, const std::vector<size_t>& stops,
+                             const LabelPosition& position) const;
     SphereProjector MakeSphereProjector() const;
-    std::vector<geo::Coordinates> GetUpdatedCoords(std::vector<const Stop*> stops, SphereProjector proj) const;
+    // Проецирует все остановки справочника текущей проекцией в stop_xs_ и stop_ys_
+    void ProjectStops();
+    svg::Point GetProjectedPoint(const Stop* stop) const {
+        return {stop_xs_[stop->id], stop_ys_[stop->id]};
+    }
     RenderSettingsHandler rsh_;
     TransportCatalogue& tc_;
     SphereProjector projected_coords_;
-    svg::Document final_drawing_;
-    
+    // Широты и долготы всех остановок справочника по их id и те же остановки на карте.
+    // Размер массивов кратен SphereProjector::PROJECT_BLOCK, хвост заполнен нулями
+    std::vector<double> stop_latitudes_;
+    std::vector<double> stop_longitudes_;
+    std::vector<double> stop_xs_;
+    std::vector<double> stop_ys_;
+    // Раскладка подписей полной карты
+    LabelChoices label_choices_;
+    // Непустые маршруты и остановки на маршрутах, по возрастанию названий
+    std::vector<const Bus*> sorted_routes_;
+    std::vector<const Stop*> sorted_stops_;
+    // Индекс по остановкам из sorted_stops_ и рамки маршрутов из sorted_routes_
+    // для запросов части карты; строятся при первом таком запросе
+    geo::GridIndex stop_index_;
+    std::vector<geo::Box> route_boxes_;
+    std::optional<uint64_t> index_version_;
+    // Охват сети и хеш справочника, считаются вместе с индексом
+    geo::Box network_box_;
+    uint64_t catalogue_hash_ = 0;
+    uint64_t settings_hash_ = 0;
+
+    // Версии справочника и настроек, для которых отрисован map_json_
+    std::optional<std::pair<uint64_t, uint64_t>> rendered_versions_;
+    uint64_t settings_version_ = 0;
+    std::string map_json_;
+    // Фрагменты каждого слоя в порядке вывода; проекция и версия настроек, для которых они нарисованы
+    std::vector<Fragment> fragments_[std::size(LAYERS)];
+    std::optional<std::pair<SphereProjector, uint64_t>> fragments_basis_;
 };
 
 
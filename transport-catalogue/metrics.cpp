@@ -0,0 +1,264 @@
+#include "metrics.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+
+using namespace std::literals;
+
+namespace metrics {
+
+namespace {
+
+double ToMs(int64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+// Writer умеет только int, большие счётчики уходят числом с плавающей точкой
+void WriteCount(json::Writer& writer, uint64_t count) {
+    if (count <= static_cast<uint64_t>(INT_MAX)) {
+        writer.Value(static_cast<int>(count));
+    } else {
+        writer.Value(static_cast<double>(count));
+    }
+}
+
+size_t GetBucket(int64_t ns) {
+    uint64_t micros = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+    size_t bucket = 0;
+    while (micros > 0 && bucket + 1 < Histogram::BUCKET_COUNT) {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+} // namespace
+
+void Histogram::Record(Clock::duration duration) {
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    ++buckets_[GetBucket(ns)];
+    min_ns_ = count_ == 0 ? ns : std::min(min_ns_, ns);
+    max_ns_ = count_ == 0 ? ns : std::max(max_ns_, ns);
+    total_ns_ += ns;
+    ++count_;
+}
+
+void Histogram::Merge(const Histogram& other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    min_ns_ = count_ == 0 ? other.min_ns_ : std::min(min_ns_, other.min_ns_);
+    max_ns_ = count_ == 0 ? other.max_ns_ : std::max(max_ns_, other.max_ns_);
+    total_ns_ += other.total_ns_;
+    count_ += other.count_;
+}
+
+double Histogram::GetQuantileMs(double q) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(count_) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            const double upper_ms = static_cast<double>(uint64_t{1} << i) / 1e3;
+            return std::min(upper_ms, ToMs(max_ns_));
+        }
+    }
+    return ToMs(max_ns_);
+}
+
+void Histogram::Write(json::Writer& writer) const {
+    // Пустые корзины не выводятся: le_us — верхняя граница корзины
+    writer.StartDict()
+    .Key("buckets"sv).StartArray();
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        if (buckets_[i] == 0) {
+            continue;
+        }
+        writer.StartDict().Key("count"sv);
+        WriteCount(writer, buckets_[i]);
+        writer.Key("le_us"sv).Value(static_cast<double>(uint64_t{1} << i))
+        .EndDict();
+    }
+    writer.EndArray()
+    .Key("count"sv);
+    WriteCount(writer, count_);
+    writer.Key("max_ms"sv).Value(ToMs(max_ns_))
+    .Key("mean_ms"sv).Value(count_ == 0 ? 0.0 : ToMs(total_ns_) / static_cast<double>(count_))
+    .Key("min_ms"sv).Value(ToMs(min_ns_))
+    .Key("p50_ms"sv).Value(GetQuantileMs(0.5))
+    .Key("p90_ms"sv).Value(GetQuantileMs(0.9))
+    .Key("p99_ms"sv).Value(GetQuantileMs(0.99))
+    .Key("total_ms"sv).Value(ToMs(total_ns_))
+    .EndDict();
+}
+
+Registry& Registry::Instance() {
+    static Registry registry;
+    return registry;
+}
+
+void Registry::RecordPhase(std::string_view phase, Clock::duration duration) {
+    std::lock_guard lock(mutex_);
+    auto it = phases_.find(phase);
+    if (it == phases_.end()) {
+        it = phases_.emplace(std::string(phase), Histogram{}).first;
+    }
+    it->second.Record(duration);
+}
+
+void Registry::RecordPhase(std::string_view phase, Clock::duration duration, const perf::Counts& counts) {
+    RecordPhase(phase, duration);
+    std::lock_guard lock(mutex_);
+    auto it = hardware_.find(phase);
+    if (it == hardware_.end()) {
+        it = hardware_.emplace(std::string(phase), perf::Counts{}).first;
+    }
+    for (size_t i = 0; i < perf::EVENT_COUNT; ++i) {
+        it->second[i] += counts[i];
+    }
+}
+
+void Registry::MergeRequests(std::string_view type, const Histogram& latencies) {
+    if (latencies.IsEmpty()) {
+        return;
+    }
+    std::lock_guard lock(mutex_);
+    auto it = requests_.find(type);
+    if (it == requests_.end()) {
+        it = requests_.emplace(std::string(type), Histogram{}).first;
+    }
+    it->second.Merge(latencies);
+}
+
+void Registry::Increment(std::string_view counter, uint64_t value) {
+    std::lock_guard lock(mutex_);
+    auto it = counters_.find(counter);
+    if (it == counters_.end()) {
+        it = counters_.emplace(std::string(counter), 0).first;
+    }
+    it->second += value;
+}
+
+void Registry::WriteHardware(json::Writer& writer) const {
+    // {"error", "events", "phases"}: error — почему часть счётчиков недоступна,
+    // events — открывшиеся счётчики, phases — их суммы по фазам и instructions per cycle
+    using perf::CYCLES;
+    using perf::INSTRUCTIONS;
+
+    writer.Key("hardware"sv).StartDict();
+    if (!perf::GetError().empty()) {
+        writer.Key("error"sv).Value(perf::GetError());
+    }
+    writer.Key("events"sv).StartArray();
+    for (size_t i = 0; i < perf::EVENT_COUNT; ++i) {
+        if (perf::IsAvailable(i)) {
+            writer.Value(perf::EVENT_NAMES[i]);
+        }
+    }
+    writer.EndArray()
+    .Key("phases"sv).StartDict();
+    for (const auto& [name, counts] : hardware_) {
+        writer.Key(name).StartDict();
+        for (size_t i = 0; i < perf::EVENT_COUNT; ++i) {
+            if (perf::IsAvailable(i)) {
+                writer.Key(perf::EVENT_NAMES[i]).Value(counts[i]);
+            }
+        }
+        if (perf::IsAvailable(CYCLES) && perf::IsAvailable(INSTRUCTIONS) && counts[CYCLES] > 0) {
+            writer.Key("ipc"sv).Value(counts[INSTRUCTIONS] / counts[CYCLES]);
+        }
+        writer.EndDict();
+    }
+    writer.EndDict()
+    .EndDict();
+}
+
+void Registry::Write(json::Writer& writer) const {
+    const auto uptime = Clock::now() - start_;
+    std::lock_guard lock(mutex_);
+    writer.StartDict()
+    .Key("counters"sv).StartDict();
+    for (const auto& [name, value] : counters_) {
+        writer.Key(name);
+        WriteCount(writer, value);
+    }
+    writer.EndDict();
+    if (perf::IsRequested()) {
+        WriteHardware(writer);
+    }
+    writer.Key("phases"sv).StartDict();
+    for (const auto& [name, histogram] : phases_) {
+        writer.Key(name);
+        histogram.Write(writer);
+    }
+    writer.EndDict()
+    .Key("requests"sv).StartDict();
+    for (const auto& [name, histogram] : requests_) {
+        writer.Key(name);
+        histogram.Write(writer);
+    }
+    writer.EndDict()
+    .Key("uptime_ms"sv).Value(std::chrono::duration<double, std::milli>(uptime).count())
+    .EndDict();
+}
+
+TimedStreamBuf::~TimedStreamBuf() {
+    Registry::Instance().RecordPhase(phase_, spent_);
+}
+
+TimedStreamBuf::int_type TimedStreamBuf::overflow(int_type ch) {
+    const auto start = Clock::now();
+    const int_type result = traits_type::eq_int_type(ch, traits_type::eof())
+        ? traits_type::not_eof(ch)
+        : target_->sputc(traits_type::to_char_type(ch));
+    spent_ += Clock::now() - start;
+    return result;
+}
+
+std::streamsize TimedStreamBuf::xsputn(const char* data, std::streamsize count) {
+    const auto start = Clock::now();
+    const std::streamsize written = target_->sputn(data, count);
+    const auto end = Clock::now();
+    spent_ += end - start;
+    if (trace::IsEnabled()) {
+        trace::Record(phase_, start, end);
+    }
+    return written;
+}
+
+int TimedStreamBuf::sync() {
+    const auto start = Clock::now();
+    const int result = target_->pubsync();
+    spent_ += Clock::now() - start;
+    return result;
+}
+
+ExitDump::~ExitDump() {
+    if (path_.empty()) {
+        json::Writer writer(std::cerr);
+        Registry::Instance().Write(writer);
+        writer.Flush();
+        std::cerr << std::endl;
+        return;
+    }
+    std::ofstream out(path_);
+    if (!out) {
+        std::cerr << "cannot write metrics to "sv << path_ << std::endl;
+        return;
+    }
+    json::Writer writer(out);
+    Registry::Instance().Write(writer);
+    writer.Flush();
+    out << '\n';
+}
+
+} // namespace metrics
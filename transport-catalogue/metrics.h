@@ -0,0 +1,149 @@
+#pragma once
+
+#include "perf_counters.h"
+#include "trace.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+namespace json {
+class Writer;
+}
+
+namespace metrics {
+
+using Clock = std::chrono::steady_clock;
+
+// Гистограмма длительностей с логарифмическими корзинами:
+// корзина i > 0 считает значения из [2^(i-1), 2^i) микросекунд, корзина 0 — меньше микросекунды
+class Histogram {
+public:
+    static constexpr size_t BUCKET_COUNT = 40;
+
+    void Record(Clock::duration duration);
+    void Merge(const Histogram& other);
+
+    uint64_t GetCount() const {
+        return count_;
+    }
+    bool IsEmpty() const {
+        return count_ == 0;
+    }
+    // Верхняя граница корзины, в которую попал квантиль q, но не больше максимума
+    double GetQuantileMs(double q) const;
+    // {"buckets", "count", "max_ms", "mean_ms", "min_ms", "p50_ms", "p90_ms", "p99_ms", "total_ms"}
+    void Write(json::Writer& writer) const;
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> buckets_{};
+    uint64_t count_ = 0;
+    int64_t total_ns_ = 0;
+    int64_t min_ns_ = 0;
+    int64_t max_ns_ = 0;
+};
+
+// Общий на процесс реестр замеров: длительности фаз, задержки запросов по типам и счётчики.
+// Потокобезопасен; на горячем пути лучше копить локальную Histogram и вливать её через Merge*
+class Registry {
+public:
+    static Registry& Instance();
+
+    void RecordPhase(std::string_view phase, Clock::duration duration);
+    // То же с аппаратными счётчиками за время фазы
+    void RecordPhase(std::string_view phase, Clock::duration duration, const perf::Counts& counts);
+    void MergeRequests(std::string_view type, const Histogram& latencies);
+    void Increment(std::string_view counter, uint64_t value = 1);
+
+    // {"counters", "hardware", "phases", "requests", "uptime_ms"};
+    // "hardware" — только если счётчики запрашивались (perf::Start)
+    void Write(json::Writer& writer) const;
+
+private:
+    Registry() = default;
+    void WriteHardware(json::Writer& writer) const;
+
+    const Clock::time_point start_ = Clock::now();
+    mutable std::mutex mutex_;
+    std::map<std::string, Histogram, std::less<>> phases_;
+    // Суммы счётчиков по фазам; счётчики общие на процесс, поэтому в фазу попадает
+    // и работа других потоков, шедшая одновременно с ней
+    std::map<std::string, perf::Counts, std::less<>> hardware_;
+    std::map<std::string, Histogram, std::less<>> requests_;
+    std::map<std::string, uint64_t, std::less<>> counters_;
+};
+
+// Замер фазы от создания до разрушения объекта; при включённой трассировке — и интервал в trace,
+// при включённых аппаратных счётчиках — и их значения
+class PhaseTimer {
+public:
+    explicit PhaseTimer(std::string_view phase)
+        : phase_(phase) {
+        if (perf::IsEnabled()) {
+            perf_start_ = perf::Read();
+            start_ = Clock::now();
+        }
+    }
+    ~PhaseTimer() {
+        const Clock::time_point end = Clock::now();
+        if (perf::IsEnabled()) {
+            Registry::Instance().RecordPhase(phase_, end - start_, perf::Difference(perf_start_, perf::Read()));
+        } else {
+            Registry::Instance().RecordPhase(phase_, end - start_);
+        }
+        if (trace::IsEnabled()) {
+            trace::Record(phase_, start_, end);
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    std::string_view phase_;
+    perf::Reading perf_start_;
+    Clock::time_point start_ = Clock::now();
+};
+
+// Пропускает вывод в другой буфер и считает время записи как фазу.
+// Замер один на весь объект, а не на каждую запись; в trace попадает каждая запись
+class TimedStreamBuf : public std::streambuf {
+public:
+    TimedStreamBuf(std::streambuf* target, std::string_view phase)
+        : target_(target), phase_(phase) {}
+    ~TimedStreamBuf() override;
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int sync() override;
+
+private:
+    std::streambuf* target_;
+    std::string_view phase_;
+    Clock::duration spent_{};
+};
+
+// Печатает реестр в поток при разрушении — в конце main
+class ExitDump {
+public:
+    explicit ExitDump(std::string path)
+        : path_(std::move(path)) {}
+    ~ExitDump();
+
+private:
+    // Пустой путь — std::cerr
+    std::string path_;
+};
+
+} // namespace metrics
+
+#define METRICS_CONCAT_INTERNAL(X, Y) X ## Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+#define MEASURE_PHASE(x) metrics::PhaseTimer METRICS_CONCAT(phaseTimer, __LINE__)(x)
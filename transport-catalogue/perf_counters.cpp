@@ -0,0 +1,113 @@
+#include "perf_counters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#define PERF_HAS_EVENTS
+#endif
+
+using namespace std::literals;
+
+namespace perf {
+
+namespace detail {
+bool enabled = false;
+}
+
+namespace {
+
+bool requested = false;
+std::string error;
+std::array<int, EVENT_COUNT> descriptors = {-1, -1, -1, -1};
+
+#ifdef PERF_HAS_EVENTS
+// В порядке EVENT_NAMES
+constexpr std::array<uint64_t, EVENT_COUNT> EVENT_CONFIGS = {
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS
+};
+
+int OpenEvent(uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Только пользовательский код: так счётчики доступны при perf_event_paranoid <= 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+} // namespace
+
+bool Start() {
+    requested = true;
+#ifdef PERF_HAS_EVENTS
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        descriptors[i] = OpenEvent(EVENT_CONFIGS[i]);
+        if (descriptors[i] < 0 && error.empty()) {
+            error = "perf_event_open("s + std::string(EVENT_NAMES[i]) + "): "s + std::strerror(errno);
+        }
+        detail::enabled = detail::enabled || descriptors[i] >= 0;
+    }
+#else
+    error = "perf_event_open is not supported on this platform"s;
+#endif
+    return detail::enabled;
+}
+
+bool IsRequested() {
+    return requested;
+}
+
+bool IsAvailable(size_t event) {
+    return descriptors[event] >= 0;
+}
+
+const std::string& GetError() {
+    return error;
+}
+
+Reading Read() {
+    Reading reading;
+#ifdef PERF_HAS_EVENTS
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        if (descriptors[i] < 0) {
+            continue;
+        }
+        // {value, time_enabled, time_running} по read_format
+        uint64_t data[3];
+        if (::read(descriptors[i], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data))) {
+            reading.values[i] = data[0];
+            reading.enabled[i] = data[1];
+            reading.running[i] = data[2];
+        }
+    }
+#endif
+    return reading;
+}
+
+Counts Difference(const Reading& begin, const Reading& end) {
+    Counts counts{};
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        const uint64_t running = end.running[i] - begin.running[i];
+        if (running == 0) {
+            continue;
+        }
+        const double scale = static_cast<double>(end.enabled[i] - begin.enabled[i]) / static_cast<double>(running);
+        counts[i] = static_cast<double>(end.values[i] - begin.values[i]) * scale;
+    }
+    return counts;
+}
+
+} // namespace perf
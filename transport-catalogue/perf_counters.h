@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Аппаратные счётчики процессора через perf_event_open (только Linux).
+// Счётчики открываются на весь процесс с наследованием, поэтому учитывают и потоки,
+// созданные после Start. Недоступный счётчик (контейнер, виртуальная машина,
+// perf_event_paranoid) просто пропускается; если не открылся ни один — запись выключена
+namespace perf {
+
+inline constexpr size_t EVENT_COUNT = 4;
+// Номера счётчиков в Reading и Counts
+inline constexpr size_t BRANCH_MISSES = 0;
+inline constexpr size_t CACHE_MISSES = 1;
+inline constexpr size_t CYCLES = 2;
+inline constexpr size_t INSTRUCTIONS = 3;
+// Имена для вывода, в порядке возрастания
+inline constexpr std::array<std::string_view, EVENT_COUNT> EVENT_NAMES = {
+    "branch_misses", "cache_misses", "cycles", "instructions"
+};
+
+// Сырые значения: при мультиплексировании счётчик работает не всё время,
+// и значение масштабируется по отношению enabled / running
+struct Reading {
+    std::array<uint64_t, EVENT_COUNT> values{};
+    std::array<uint64_t, EVENT_COUNT> enabled{};
+    std::array<uint64_t, EVENT_COUNT> running{};
+};
+
+using Counts = std::array<double, EVENT_COUNT>;
+
+namespace detail {
+extern bool enabled;
+}
+
+// true, если открыт хотя бы один счётчик. Меняется только в Start,
+// до запуска рабочих потоков, поэтому читается без синхронизации
+inline bool IsEnabled() {
+    return detail::enabled;
+}
+
+// Открывает счётчики; вызывается один раз до создания потоков
+bool Start();
+// Был ли вызван Start — чтобы отличить «не просили» от «недоступно»
+bool IsRequested();
+bool IsAvailable(size_t event);
+// Причина недоступности первого неоткрывшегося счётчика
+const std::string& GetError();
+
+Reading Read();
+// События между двумя чтениями, с поправкой на мультиплексирование
+Counts Difference(const Reading& begin, const Reading& end);
+
+} // namespace perf
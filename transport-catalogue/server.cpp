@@ -0,0 +1,388 @@
+#include "server.h"
+#include "metrics.h"
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SERVER_HAS_UNIX_SOCKETS
+#endif
+
+using namespace std::literals;
+
+// Разбор уже прочитанного текста; при чтении из потока в замер попало бы ожидание ввода
+static json::Document ParseRequestText(std::string_view text) {
+    MEASURE_PHASE("json_parse");
+    return json::Load(text);
+}
+
+// Текст очередного документа: до парной закрывающей скобки с учётом строк
+// и экранирования, а для скаляра — до пробельного символа. Сам документ
+// разбирается отдельно, поэтому ошибка в нём не сбивает чтение следующих пакетов
+static std::string ReadDocument(std::istream& input) {
+    using Traits = std::char_traits<char>;
+    std::streambuf* buffer = input.rdbuf();
+    std::string text;
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    for (Traits::int_type ch = buffer->sbumpc(); !Traits::eq_int_type(ch, Traits::eof()); ch = buffer->sbumpc()) {
+        const char c = Traits::to_char_type(ch);
+        text += c;
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+                if (depth == 0) {
+                    return text;
+                }
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth <= 0) {
+                return text;
+            }
+        } else if (depth == 0 && std::isspace(static_cast<unsigned char>(c))) {
+            return text;
+        }
+    }
+    input.setstate(std::ios::eofbit);
+    return text;
+}
+
+void Server::ServeStream(std::istream& input, std::ostream& output) {
+    while (input >> std::ws && input.peek() != std::char_traits<char>::eof()) {
+        ProcessBatchText(ReadDocument(input), output);
+    }
+}
+
+void Server::ProcessBatchText(std::string_view text, std::ostream& output) {
+    try {
+        ProcessBatch(ParseRequestText(text).GetRoot(), output);
+    } catch (const std::exception& e) {
+        // Ошибка в пакете не должна останавливать сервер, а его запросы —
+        // попадать в ответ на следующий пакет
+        manager_.DiscardStatRequests();
+        std::cerr << "batch failed: "sv << e.what() << std::endl;
+        {
+            json::Writer writer(output, json::Layout::COMPACT);
+            writer.StartDict().Key("error_message"sv).Value(e.what()).EndDict();
+        }
+        output << '\n';
+        output.flush();
+    }
+}
+
+void Server::ServeLines(std::istream& input, std::ostream& output) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    size_t line_count = 0;
+
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+            continue;
+        }
+        ++line_count;
+        // Ответ собирается отдельно: при ошибке посреди ответа
+        // в вывод не попадёт его незаконченная часть
+        std::string response;
+        try {
+            const json::Document request = ParseRequestText(line);
+            if (!request.GetRoot().IsMap()) {
+                throw std::invalid_argument("Each line must hold one request object"s);
+            }
+            manager_.ParseStatRequests(request.GetRoot());
+            if (manager_.GetPendingRequestsCount() == 0) {
+                throw std::invalid_argument("Unsupported request"s);
+            }
+            json::Writer writer(0, json::Layout::COMPACT);
+            manager_.WriteResponses(writer, pool_);
+            response = writer.Release();
+        } catch (const std::exception& e) {
+            manager_.DiscardStatRequests();
+            json::Writer writer(0, json::Layout::COMPACT);
+            writer.StartDict().Key("error_message"sv).Value(e.what()).EndDict();
+            response = writer.Release();
+        }
+        // Ответ уходит клиенту сразу, не дожидаясь следующих строк
+        output << response << '\n';
+        output.flush();
+    }
+
+    const auto duration = std::chrono::duration<double, std::milli>(Clock::now() - start);
+    std::cerr << "ndjson: "sv << line_count << " requests, "sv << duration.count() << " ms"sv << std::endl;
+}
+
+void Server::ProcessBatch(const json::Node& batch, std::ostream& output) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    metrics::Registry::Instance().Increment("batches");
+
+    const auto& batch_map = batch.AsMap();
+    if (batch_map.count("base_requests") > 0 || batch_map.count("render_settings") > 0
+        || batch_map.count("routing_settings") > 0) {
+        manager_.LoadBase(batch_map);
+    }
+    if (batch_map.count("stat_requests") > 0) {
+        manager_.ParseStatRequests(batch_map.at("stat_requests"));
+    }
+    const size_t request_count = manager_.GetPendingRequestsCount();
+    manager_.WriteResponses(output, pool_);
+    output << '\n';
+    output.flush();
+
+    const auto duration = std::chrono::duration<double, std::milli>(Clock::now() - start);
+    std::cerr << "batch "sv << ++batch_count_ << ": "sv << request_count << " requests, "sv
+              << duration.count() << " ms"sv << std::endl;
+}
+
+#ifdef SERVER_HAS_UNIX_SOCKETS
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+// Буфер вывода поверх сокета. Разрыв соединения клиентом
+// не должен завершать сервер сигналом SIGPIPE
+class FdOutBuf : public std::streambuf {
+public:
+    explicit FdOutBuf(int fd)
+        : fd_(fd) {
+        setp(buffer_, buffer_ + sizeof(buffer_));
+    }
+    ~FdOutBuf() override {
+        sync();
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (sync() != 0) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        const char* data = pbase();
+        while (data < pptr()) {
+            const ssize_t written = ::send(fd_, data, static_cast<size_t>(pptr() - data), SEND_FLAGS);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            data += written;
+        }
+        setp(buffer_, buffer_ + sizeof(buffer_));
+        return 0;
+    }
+
+private:
+    int fd_;
+    char buffer_[1 << 16];
+};
+
+std::string ReadAll(int fd) {
+    std::string result;
+    char buffer[1 << 16];
+    while (true) {
+        const ssize_t received = ::read(fd, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return result;
+        }
+        result.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+// Весь пакет должен прийти за это время: клиент, не закрывший запись,
+// иначе занял бы сервер, который обслуживает соединения по одному
+constexpr std::chrono::seconds REQUEST_TIMEOUT{10};
+
+// Как ReadAll, но не дольше timeout от начала чтения; nullopt, если время вышло
+std::optional<std::string> ReadRequest(int fd, std::chrono::milliseconds timeout) {
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + timeout;
+    std::string result;
+    char buffer[1 << 16];
+    while (true) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        if (left.count() <= 0) {
+            return std::nullopt;
+        }
+        pollfd descriptor{fd, POLLIN, 0};
+        const int ready = ::poll(&descriptor, 1, static_cast<int>(left.count()));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready == 0) {
+            return std::nullopt;
+        }
+        const ssize_t received = ready < 0 ? -1 : ::read(fd, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return result;
+        }
+        result.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+// Ошибки accept, после которых можно принимать следующие соединения:
+// клиент ушёл до accept или временно не хватило дескрипторов или памяти
+bool IsTransientAcceptError(int error) {
+    switch (error) {
+        case EINTR:
+        case EAGAIN:
+        case ECONNABORTED:
+        case EPROTO:
+        case EPERM:
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+sockaddr_un MakeAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: "s + path);
+    }
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+}  // namespace
+
+void Server::ServeSocket(const std::string& path) {
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("Can't create socket: "s + std::strerror(errno));
+    }
+    const sockaddr_un address = MakeAddress(path);
+    // Удаляется только сокет, оставшийся от прошлого запуска: обычный файл
+    // по ошибочному пути стирать нельзя
+    struct stat status{};
+    if (::lstat(path.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            ::close(listener);
+            throw std::runtime_error("Can't listen on "s + path + ": file exists and is not a socket"s);
+        }
+        ::unlink(path.c_str());
+    }
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(listener, 16) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(listener);
+        throw std::runtime_error("Can't listen on "s + path + ": "s + error);
+    }
+    std::cerr << "listening on "sv << path << std::endl;
+
+    while (true) {
+        const int connection = ::accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            const int error = errno;
+            if (!IsTransientAcceptError(error)) {
+                ::close(listener);
+                throw std::runtime_error("Can't accept on "s + path + ": "s + std::strerror(error));
+            }
+            if (error != EINTR && error != ECONNABORTED) {
+                // Нехватка ресурсов проходит не сразу: пауза вместо холостого цикла
+                std::cerr << "accept: "sv << std::strerror(error) << std::endl;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            continue;
+        }
+        // Клиент, который не читает ответ, тоже не должен останавливать сервер
+        const timeval send_timeout{REQUEST_TIMEOUT.count(), 0};
+        ::setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+        const std::optional<std::string> request = ReadRequest(connection, REQUEST_TIMEOUT);
+        {
+            FdOutBuf buffer(connection);
+            std::ostream output(&buffer);
+            if (request) {
+                ProcessBatchText(*request, output);
+            } else {
+                metrics::Registry::Instance().Increment("request_timeouts");
+                std::cerr << "request timed out"sv << std::endl;
+                {
+                    json::Writer writer(output, json::Layout::COMPACT);
+                    writer.StartDict().Key("error_message"sv).Value("Request timed out"sv).EndDict();
+                }
+                output << '\n';
+            }
+        }
+        ::close(connection);
+    }
+}
+
+int RunSocketClient(const std::string& path, std::istream& input, std::ostream& output) {
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    const sockaddr_un address = MakeAddress(path);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Can't connect to "sv << path << ": "sv << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return 1;
+    }
+    {
+        FdOutBuf buffer(fd);
+        std::ostream request(&buffer);
+        request << input.rdbuf();
+    }
+    ::shutdown(fd, SHUT_WR);
+    output << ReadAll(fd);
+    ::close(fd);
+    return 0;
+}
+
+#else
+
+void Server::ServeSocket(const std::string& path) {
+    throw std::runtime_error("Unix sockets are not supported on this platform: "s + path);
+}
+
+int RunSocketClient(const std::string& path, std::istream&, std::ostream&) {
+    std::cerr << "Unix sockets are not supported on this platform: "sv << path << std::endl;
+    return 1;
+}
+
+#endif
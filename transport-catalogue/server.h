@@ -0,0 +1,49 @@
+#pragma once
+
+#include "json_reader.h"
+#include "thread_pool.h"
+
+#include <iostream>
+#include <string>
+
+// Резидентный режим: справочник и маршрутизатор строятся один раз,
+// после чего процесс отвечает на пакеты stat_requests, пока не кончится ввод.
+// Пакет — JSON-документ со словарём; разделы base_requests, render_settings и
+// routing_settings дополняют справочник, раздел stat_requests — запросы пакета.
+// Ответ на пакет — JSON-массив, после которого выводится перевод строки.
+// На пакет, который не удалось разобрать или обработать, вместо массива
+// выводится {"error_message": ...}, так что ответов всегда столько же, сколько пакетов.
+// Ошибка, случившаяся уже во время вывода ответов, обрывает массив
+class Server {
+public:
+    Server(RequestManager& manager, ThreadPool* pool)
+        : manager_(manager), pool_(pool) {}
+
+    // Читает пакеты подряд из input, пока он не закончится
+    void ServeStream(std::istream& input, std::ostream& output);
+    // Построчный режим (NDJSON): каждая строка input — один запрос из stat_requests,
+    // то есть один JSON-словарь; ответ на неё — одна строка компактного JSON,
+    // которая отправляется сразу. На некорректную или неподдерживаемую строку,
+    // в том числе на массив запросов, отвечает {"error_message": ...},
+    // так что i-я строка вывода всегда соответствует i-й непустой строке ввода
+    void ServeLines(std::istream& input, std::ostream& output);
+    // Принимает соединения на Unix-сокете: одно соединение — один пакет.
+    // Клиент отправляет документ и закрывает запись, сервер отвечает и закрывает соединение.
+    // Соединения обслуживаются по одному, поэтому пакет должен прийти за 10 секунд,
+    // иначе ответом будет {"error_message": "Request timed out"}.
+    // Временные ошибки accept пропускаются; runtime_error, если слушать сокет нельзя
+    void ServeSocket(const std::string& path);
+
+private:
+    void ProcessBatch(const json::Node& batch, std::ostream& output);
+    // Разбирает и обрабатывает текст пакета, а при ошибке отвечает {"error_message": ...}
+    void ProcessBatchText(std::string_view text, std::ostream& output);
+
+    RequestManager& manager_;
+    ThreadPool* pool_;
+    size_t batch_count_ = 0;
+};
+
+// Клиент для ServeSocket: отправляет input серверу и копирует ответ в output.
+// Возвращает код завершения процесса
+int RunSocketClient(const std::string& path, std::istream& input, std::ostream& output);
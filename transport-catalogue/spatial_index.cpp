@@ -0,0 +1,77 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace geo {
+
+GridIndex::GridIndex(std::vector<Coordinates> points)
+    : points_(std::move(points)) {
+    if (points_.empty()) {
+        return;
+    }
+    bounds_ = {points_.front().lat, points_.front().lng, points_.front().lat, points_.front().lng};
+    for (const Coordinates& point : points_) {
+        bounds_.Extend(point);
+    }
+
+    // В среднем около одной точки на ячейку
+    const size_t side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(points_.size()))));
+    const double height = bounds_.max_lat - bounds_.min_lat;
+    const double width = bounds_.max_lng - bounds_.min_lng;
+    rows_ = height > 0 ? side : 1;
+    columns_ = width > 0 ? side : 1;
+    cell_lat_ = height > 0 ? height / rows_ : 1.0;
+    cell_lng_ = width > 0 ? width / columns_ : 1.0;
+
+    // Сортировка подсчётом по номеру ячейки
+    std::vector<uint32_t> cells(points_.size());
+    cell_begin_.assign(rows_ * columns_ + 1, 0);
+    for (size_t i = 0; i < points_.size(); ++i) {
+        cells[i] = static_cast<uint32_t>(CellRow(points_[i].lat) * columns_ + CellColumn(points_[i].lng));
+        ++cell_begin_[cells[i] + 1];
+    }
+    for (size_t cell = 1; cell < cell_begin_.size(); ++cell) {
+        cell_begin_[cell] += cell_begin_[cell - 1];
+    }
+    items_.resize(points_.size());
+    std::vector<uint32_t> fill(cell_begin_.begin(), cell_begin_.end() - 1);
+    for (size_t i = 0; i < points_.size(); ++i) {
+        items_[fill[cells[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+std::vector<uint32_t> GridIndex::Query(const Box& box) const {
+    std::vector<uint32_t> result;
+    if (points_.empty() || !bounds_.Intersects(box)) {
+        return result;
+    }
+    const size_t row_begin = CellRow(box.min_lat);
+    const size_t row_end = CellRow(box.max_lat);
+    const size_t column_begin = CellColumn(box.min_lng);
+    const size_t column_end = CellColumn(box.max_lng);
+    for (size_t row = row_begin; row <= row_end; ++row) {
+        const size_t first = cell_begin_[row * columns_ + column_begin];
+        const size_t last = cell_begin_[row * columns_ + column_end + 1];
+        for (size_t i = first; i < last; ++i) {
+            if (box.Contains(points_[items_[i]])) {
+                result.push_back(items_[i]);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+size_t GridIndex::CellRow(double lat) const {
+    const double row = std::floor((lat - bounds_.min_lat) / cell_lat_);
+    return static_cast<size_t>(std::clamp(row, 0.0, static_cast<double>(rows_ - 1)));
+}
+
+size_t GridIndex::CellColumn(double lng) const {
+    const double column = std::floor((lng - bounds_.min_lng) / cell_lng_);
+    return static_cast<size_t>(std::clamp(column, 0.0, static_cast<double>(columns_ - 1)));
+}
+
+}  // namespace geo
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "geo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geo {
+
+// Равномерная сетка над точками для выборки по прямоугольнику.
+// Объект задаётся номером своей точки во входном векторе.
+// Номера хранятся подряд, сгруппированными по ячейкам (как в CSR-матрице)
+class GridIndex {
+public:
+    GridIndex() = default;
+    explicit GridIndex(std::vector<Coordinates> points);
+
+    // Номера точек, попавших в box, в порядке возрастания
+    std::vector<uint32_t> Query(const Box& box) const;
+
+    size_t Size() const {
+        return points_.size();
+    }
+
+private:
+    size_t CellRow(double lat) const;
+    size_t CellColumn(double lng) const;
+
+    std::vector<Coordinates> points_;
+    Box bounds_;
+    size_t rows_ = 0;
+    size_t columns_ = 0;
+    double cell_lat_ = 0;
+    double cell_lng_ = 0;
+    // Точки ячейки c — items_[cell_begin_[c], cell_begin_[c + 1])
+    std::vector<uint32_t> cell_begin_;
+    std::vector<uint32_t> items_;
+};
+
+}  // namespace geo
@@ -1,14 +1,151 @@
 
 #include "svg.h"
 
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <sstream>
+
 namespace svg {
 
 using namespace std::literals;
 
+namespace detail {
+
+void AppendNumber(std::string& out, double value) {
+    // Совпадает с выводом double в std::ostream с точностью по умолчанию
+    char chars[32];
+    const auto [ptr, ec] = std::to_chars(std::begin(chars), std::end(chars), value,
+                                         std::chars_format::general, 6);
+    out.append(chars, ptr);
+}
+
+void AppendNumber(std::string& out, uint32_t value) {
+    char chars[16];
+    const auto [ptr, ec] = std::to_chars(std::begin(chars), std::end(chars), value);
+    out.append(chars, ptr);
+}
+
+void AppendColor(std::string& out, const Color& color) {
+    if (const auto* name = std::get_if<std::string>(&color)) {
+        out += *name;
+    } else if (const auto* rgb = std::get_if<Rgb>(&color)) {
+        out += "rgb("sv;
+        AppendNumber(out, uint32_t{rgb->red});
+        out += ',';
+        AppendNumber(out, uint32_t{rgb->green});
+        out += ',';
+        AppendNumber(out, uint32_t{rgb->blue});
+        out += ')';
+    } else if (const auto* rgba = std::get_if<Rgba>(&color)) {
+        out += "rgba("sv;
+        AppendNumber(out, uint32_t{rgba->red});
+        out += ',';
+        AppendNumber(out, uint32_t{rgba->green});
+        out += ',';
+        AppendNumber(out, uint32_t{rgba->blue});
+        out += ',';
+        AppendNumber(out, rgba->opacity);
+        out += ')';
+    } else {
+        out += "none"sv;
+    }
+}
+
+}  // namespace detail
+
+namespace {
+
+// Координата в единицах последнего выводимого знака: при относительных смещениях
+// между округлёнными целыми ошибка округления не накапливается вдоль ломаной
+long long ToFixed(double value, int precision) {
+    static constexpr double SCALES[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6};
+    return std::llround(value * SCALES[precision]);
+}
+
+// Число value / 10^precision без незначащих нулей: 12.5, -3, .25
+void AppendFixed(std::string& out, long long value, int precision) {
+    if (value < 0) {
+        out += '-';
+        value = -value;
+    }
+    char digits[32];
+    auto [ptr, ec] = std::to_chars(std::begin(digits), std::end(digits), value);
+    std::string_view number(digits, ptr - digits);
+    const size_t int_size = number.size() > size_t(precision) ? number.size() - precision : 0;
+    out += number.substr(0, int_size);
+    std::string fraction(precision - std::min<size_t>(precision, number.size()), '0');
+    fraction += number.substr(int_size);
+    while (!fraction.empty() && fraction.back() == '0') {
+        fraction.pop_back();
+    }
+    if (!fraction.empty()) {
+        out += '.';
+        out += fraction;
+    } else if (int_size == 0) {
+        out += '0';
+    }
+}
+
+// Несколько чисел подряд: пробел нужен только перед неотрицательным
+void AppendFixedList(std::string& out, std::initializer_list<long long> values, int precision) {
+    bool first = true;
+    for (const long long value : values) {
+        if (!first && value >= 0) {
+            out += ' ';
+        }
+        AppendFixed(out, value, precision);
+        first = false;
+    }
+}
+
+// Атрибуты стиля name="value" в виде CSS-объявлений name:value.
+// Длины в CSS записываются с единицами, в атрибутах — без
+void AppendCss(std::string& out, std::string_view attrs) {
+    bool first = true;
+    while (true) {
+        const size_t name_begin = attrs.find_first_not_of(' ');
+        const size_t name_end = attrs.find("=\""sv, name_begin);
+        if (name_begin == std::string_view::npos || name_end == std::string_view::npos) {
+            break;
+        }
+        const size_t value_end = attrs.find('"', name_end + 2);
+        const std::string_view name = attrs.substr(name_begin, name_end - name_begin);
+        const std::string_view value = attrs.substr(name_end + 2, value_end - name_end - 2);
+        if (!first) {
+            out += ';';
+        }
+        out += name;
+        out += ':';
+        out += value;
+        if (name == "stroke-width"sv || name == "font-size"sv) {
+            out += "px"sv;
+        }
+        first = false;
+        attrs.remove_prefix(value_end + 1);
+    }
+}
+
+}  // namespace
+
 void Object::Render(const RenderContext& context) const {
     context.RenderIndent();
     RenderObject(context);
-    context.out << std::endl;
+    context.out << '\n';
+}
+
+// ---------- ObjectContainer ------------------
+
+void ObjectContainer::AddShape(const Circle& circle) {
+    AddPtr(std::make_unique<Circle>(circle));
+}
+
+void ObjectContainer::AddShape(const Polyline& polyline) {
+    AddPtr(std::make_unique<Polyline>(polyline));
+}
+
+void ObjectContainer::AddShape(const Text& text) {
+    AddPtr(std::make_unique<Text>(text));
 }
 
 // ---------- Circle ------------------
@@ -109,19 +246,246 @@ void Text::RenderObject(const RenderContext& context) const {
 
 // ---------- Document ------------------
 
+void Document::AddPtr(std::unique_ptr<Object>&& obj) {
+    commands_.push_back({CommandKind::OBJECT, static_cast<uint32_t>(objects_.size()), 0, 0, 0});
+    objects_.push_back(std::move(obj));
+}
 
+void Document::AddShape(const Circle& circle) {
+    style_scratch_.clear();
+    circle.AppendAttrs(style_scratch_);
+    commands_.push_back({CommandKind::CIRCLE, InternStyle(), static_cast<uint32_t>(coords_.size()), 0, 0});
+    coords_.insert(coords_.end(), {circle.center_.x, circle.center_.y, circle.radius_});
+}
 
-void Document::Render(std::ostream& out) const {
+void Document::AddShape(const Polyline& polyline) {
+    style_scratch_.clear();
+    polyline.AppendAttrs(style_scratch_);
+    commands_.push_back({CommandKind::POLYLINE, InternStyle(), static_cast<uint32_t>(coords_.size()),
+                         static_cast<uint32_t>(polyline.points_.size()), 0});
+    for (const Point& point : polyline.points_) {
+        coords_.push_back(point.x);
+        coords_.push_back(point.y);
+    }
+}
+
+void Document::AddShape(const Text& text) {
+    // Шрифт входит в стиль: у подписей одного вида он одинаковый
+    style_scratch_.clear();
+    if (text.font_size_ > 0) {
+        style_scratch_ += "font-size=\""sv;
+        detail::AppendNumber(style_scratch_, text.font_size_);
+        style_scratch_ += "\" "sv;
+    }
+    if (!text.font_family_.empty()) {
+        style_scratch_ += "font-family=\""sv;
+        style_scratch_ += text.font_family_;
+        style_scratch_ += "\" "sv;
+    }
+    if (!text.font_weight_.empty()) {
+        style_scratch_ += "font-weight=\""sv;
+        style_scratch_ += text.font_weight_;
+        style_scratch_ += "\" "sv;
+    }
+    text.AppendAttrs(style_scratch_);
+    commands_.push_back({CommandKind::TEXT, InternStyle(), static_cast<uint32_t>(coords_.size()),
+                         static_cast<uint32_t>(text.data_.size()), static_cast<uint32_t>(text_.size())});
+    coords_.insert(coords_.end(), {text.position_.x, text.position_.y, text.offset_.x, text.offset_.y});
+    text_ += text.data_;
+}
+
+uint32_t Document::InternStyle() {
+    const auto [it, inserted] = style_ids_.emplace(style_scratch_, static_cast<uint32_t>(styles_.size()));
+    if (inserted) {
+        styles_.push_back(&it->first);
+    }
+    return it->second;
+}
+
+void Document::Render(std::ostream& out, const CompactFormat* compact) const {
+    RenderBegin(out);
+    RenderContent(out, compact);
+    RenderEnd(out);
+}
+
+void Document::RenderBegin(std::ostream& out) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+}
+
+void Document::RenderEnd(std::ostream& out) {
+    out << "</svg>\n"sv;
+}
+
+void Document::RenderContent(std::ostream& out, const CompactFormat* compact) const {
+    static constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+    std::string buffer;
+    buffer.reserve(FLUSH_THRESHOLD * 2);
+    const auto flush = [&out, &buffer] {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    if (compact != nullptr) {
+        AppendStyleSheet(buffer, *compact);
+    }
     RenderContext context(out);
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" << std::endl;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">" << std::endl;
+    for (const Command& command : commands_) {
+        if (command.kind == CommandKind::OBJECT) {
+            flush();
+            objects_[command.style]->Render(context);
+        } else if (compact != nullptr) {
+            AppendCompactCommand(buffer, command, *compact);
+        } else {
+            AppendCommand(buffer, command);
+        }
+        if (buffer.size() >= FLUSH_THRESHOLD) {
+            flush();
+        }
+    }
+
+    flush();
+}
+
+void Document::AppendContent(std::string& out, size_t begin, size_t end) const {
+    for (size_t i = begin; i < end; ++i) {
+        const Command& command = commands_[i];
+        if (command.kind == CommandKind::OBJECT) {
+            std::ostringstream object_out;
+            objects_[command.style]->Render(RenderContext(object_out));
+            out += object_out.str();
+        } else {
+            AppendCommand(out, command);
+        }
+    }
+}
 
-    for (const auto& object : objects_) {
-        object->Render(context);
+void Document::AppendCommand(std::string& buffer, const Command& command) const {
+    const auto attr = [&buffer](std::string_view prefix, double value) {
+        buffer += prefix;
+        detail::AppendNumber(buffer, value);
+    };
+    const double* coords = coords_.data() + command.coords;
+    switch (command.kind) {
+        case CommandKind::CIRCLE:
+            attr("<circle cx=\""sv, coords[0]);
+            attr("\" cy=\""sv, coords[1]);
+            attr("\" r=\""sv, coords[2]);
+            buffer += "\" "sv;
+            buffer += *styles_[command.style];
+            buffer += "/>\n"sv;
+            break;
+        case CommandKind::POLYLINE:
+            buffer += "<polyline points=\""sv;
+            for (uint32_t i = 0; i < command.count; ++i) {
+                if (i > 0) {
+                    buffer += ' ';
+                }
+                detail::AppendNumber(buffer, coords[2 * i]);
+                buffer += ',';
+                detail::AppendNumber(buffer, coords[2 * i + 1]);
+            }
+            buffer += "\" "sv;
+            buffer += *styles_[command.style];
+            buffer += "/>\n"sv;
+            break;
+        case CommandKind::TEXT:
+            attr("<text x=\""sv, coords[0]);
+            attr("\" y=\""sv, coords[1]);
+            attr("\" dx=\""sv, coords[2]);
+            attr("\" dy=\""sv, coords[3]);
+            buffer += "\" "sv;
+            buffer += *styles_[command.style];
+            buffer += '>';
+            buffer.append(text_, command.text, command.count);
+            buffer += "</text>\n"sv;
+            break;
+        case CommandKind::OBJECT:
+            break;
     }
+}
 
-    out << "</svg>" << std::endl;
+void Document::AppendCompactCommand(std::string& buffer, const Command& command,
+                                    const CompactFormat& compact) const {
+    const int precision = std::clamp(compact.precision, 0, 6);
+    const auto number = [&buffer, precision](double value) {
+        AppendFixed(buffer, ToFixed(value, precision), precision);
+    };
+    const auto class_attr = [&buffer, &compact, &command] {
+        buffer += "class=\""sv;
+        buffer += compact.class_prefix;
+        detail::AppendNumber(buffer, command.style);
+        buffer += '"';
+    };
+    const double* coords = coords_.data() + command.coords;
+    switch (command.kind) {
+        case CommandKind::CIRCLE:
+            buffer += "<circle cx=\""sv;
+            number(coords[0]);
+            buffer += "\" cy=\""sv;
+            number(coords[1]);
+            buffer += "\" r=\""sv;
+            number(coords[2]);
+            buffer += "\" "sv;
+            class_attr();
+            buffer += "/>"sv;
+            break;
+        case CommandKind::POLYLINE: {
+            // M x y, затем l dx dy ... — смещения между соседними точками
+            buffer += "<path d=\"M"sv;
+            long long x = ToFixed(coords[0], precision);
+            long long y = ToFixed(coords[1], precision);
+            AppendFixedList(buffer, {x, y}, precision);
+            if (command.count > 1) {
+                buffer += 'l';
+            }
+            for (uint32_t i = 1; i < command.count; ++i) {
+                const long long next_x = ToFixed(coords[2 * i], precision);
+                const long long next_y = ToFixed(coords[2 * i + 1], precision);
+                if (i > 1 && next_x - x >= 0) {
+                    buffer += ' ';
+                }
+                AppendFixedList(buffer, {next_x - x, next_y - y}, precision);
+                x = next_x;
+                y = next_y;
+            }
+            buffer += "\" "sv;
+            class_attr();
+            buffer += "/>"sv;
+            break;
+        }
+        case CommandKind::TEXT:
+            // Смещение dx, dy складывается с позицией: для однострочной подписи это то же самое
+            buffer += "<text x=\""sv;
+            number(coords[0] + coords[2]);
+            buffer += "\" y=\""sv;
+            number(coords[1] + coords[3]);
+            buffer += "\" "sv;
+            class_attr();
+            buffer += '>';
+            buffer.append(text_, command.text, command.count);
+            buffer += "</text>"sv;
+            break;
+        case CommandKind::OBJECT:
+            break;
+    }
 }
 
-}  // namespace svg
+void Document::AppendStyleSheet(std::string& buffer, const CompactFormat& compact) const {
+    if (styles_.empty()) {
+        return;
+    }
+    buffer += "<style>"sv;
+    for (uint32_t id = 0; id < styles_.size(); ++id) {
+        buffer += '.';
+        buffer += compact.class_prefix;
+        detail::AppendNumber(buffer, id);
+        buffer += '{';
+        AppendCss(buffer, *styles_[id]);
+        buffer += '}';
+    }
+    buffer += "</style>"sv;
+}
 
+}  // namespace svg
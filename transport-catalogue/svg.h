@@ -9,6 +9,8 @@
 #include <utility>
 #include <optional>
 #include <variant>
+#include <string_view>
+#include <unordered_map>
 namespace svg {
 struct Rgb {
     uint8_t red = 0;
@@ -50,6 +52,25 @@ inline std::ostream& operator<<(std::ostream& os, const Color& color) {
     std::visit(ColorVisitor{os}, color);
     return os;
 }
+
+namespace detail {
+// Форматирование без std::ostream: числа выводятся так же, как operator<<
+// с настройками потока по умолчанию (%g, 6 значащих цифр)
+void AppendNumber(std::string& out, double value);
+void AppendNumber(std::string& out, uint32_t value);
+void AppendColor(std::string& out, const Color& color);
+}  // namespace detail
+
+// Компактный вывод документа: координаты с фиксированным числом знаков после запятой,
+// ломаные в виде <path> с относительными смещениями, оформление — CSS-классами
+// в блоке <style> вместо атрибутов у каждой фигуры. Рисует то же изображение
+struct CompactFormat {
+    // Знаков после запятой в координатах, от 0 до 6
+    int precision = 2;
+    // Начало имён классов. Классы действуют на весь SVG, поэтому у частей,
+    // выводимых в один документ через RenderContent, начала должны различаться
+    std::string class_prefix = "s";
+};
 struct Point {
     Point() = default;
     Point(double x, double y)
@@ -83,6 +104,10 @@ struct RenderContext {
     int indent = 0;
 };
 
+class Circle;
+class Polyline;
+class Text;
+
 class Object {
 public:
     void Render(const RenderContext& context) const;
@@ -97,13 +122,15 @@ public:
     virtual ~ObjectContainer() = default;
 
     template <typename T>
-    void Add(T&& obj) {
-        static_assert(std::is_base_of_v<Object, std::decay_t<T>>, "T must derive from Object");
-        AddPtr(std::make_unique<std::decay_t<T>>(std::forward<T>(obj)));
-    }
+    void Add(T&& obj);
 
 protected:
     virtual void AddPtr(std::unique_ptr<Object>&& obj) = 0;
+    // Фигуры этой библиотеки контейнер может сохранить, не создавая объект в куче.
+    // По умолчанию они, как и любые другие Object, передаются в AddPtr
+    virtual void AddShape(const Circle& circle);
+    virtual void AddShape(const Polyline& polyline);
+    virtual void AddShape(const Text& text);
 };
 // Drawable interface
 class Drawable {
@@ -126,24 +153,32 @@ enum class StrokeLineJoin {
     MITER_CLIP,
     ROUND,
 };
-inline std::ostream& operator<<(std::ostream& out, StrokeLineCap cap) {
+inline std::string_view ToString(StrokeLineCap cap) {
     switch (cap) {
-        case StrokeLineCap::BUTT: return out << "butt";
-        case StrokeLineCap::ROUND: return out << "round";
-        case StrokeLineCap::SQUARE: return out << "square";
+        case StrokeLineCap::BUTT: return "butt";
+        case StrokeLineCap::ROUND: return "round";
+        case StrokeLineCap::SQUARE: return "square";
     }
-    return out;
+    return {};
 }
 
-inline std::ostream& operator<<(std::ostream& out, StrokeLineJoin join) {
+inline std::string_view ToString(StrokeLineJoin join) {
     switch (join) {
-        case StrokeLineJoin::ARCS: return out << "arcs";
-        case StrokeLineJoin::BEVEL: return out << "bevel";
-        case StrokeLineJoin::MITER: return out << "miter";
-        case StrokeLineJoin::MITER_CLIP: return out << "miter-clip";
-        case StrokeLineJoin::ROUND: return out << "round";
+        case StrokeLineJoin::ARCS: return "arcs";
+        case StrokeLineJoin::BEVEL: return "bevel";
+        case StrokeLineJoin::MITER: return "miter";
+        case StrokeLineJoin::MITER_CLIP: return "miter-clip";
+        case StrokeLineJoin::ROUND: return "round";
     }
-    return out;
+    return {};
+}
+
+inline std::ostream& operator<<(std::ostream& out, StrokeLineCap cap) {
+    return out << ToString(cap);
+}
+
+inline std::ostream& operator<<(std::ostream& out, StrokeLineJoin join) {
+    return out << ToString(join);
 }
 template<typename Owner>
 class PathProps{
@@ -186,22 +221,38 @@ protected:
         return line_join_;
     }
     virtual void RenderAttrs(std::ostream& out) const {
-        if (GetFillColor() != std::nullopt) {
-           out << " fill=\"" << *fill_color_ << "\"";
+        std::string attrs;
+        AppendAttrs(attrs);
+        out << attrs;
+    }
+    void AppendAttrs(std::string& out) const {
+        using namespace std::literals;
+        if (fill_color_) {
+            out += " fill=\""sv;
+            detail::AppendColor(out, *fill_color_);
+            out += '"';
         }
-        if (GetStrokeColor() != std::nullopt) {
-            out << " stroke=\"" << *stroke_color_ << "\"";
+        if (stroke_color_) {
+            out += " stroke=\""sv;
+            detail::AppendColor(out, *stroke_color_);
+            out += '"';
         }
-        if (GetStrokeWidth() != std::nullopt) {
-            out << " stroke-width=\"" << *stroke_width_ << "\"";
+        if (stroke_width_) {
+            out += " stroke-width=\""sv;
+            detail::AppendNumber(out, *stroke_width_);
+            out += '"';
         }
-        if (GetLineCap() != std::nullopt) {
-            out << " stroke-linecap=\"" << *line_cap_ << "\"";
+        if (line_cap_) {
+            out += " stroke-linecap=\""sv;
+            out += ToString(*line_cap_);
+            out += '"';
         }
-        if (GetLineJoin() != std::nullopt) {
-            out << " stroke-linejoin=\"" << *line_join_ << "\"";
+        if (line_join_) {
+            out += " stroke-linejoin=\""sv;
+            out += ToString(*line_join_);
+            out += '"';
         }
-}
+    }
 private:
     Owner& AsOwner() {
         // static_cast безопасно преобразует *this к Owner&,
@@ -222,6 +273,7 @@ public:
     Circle& SetRadius(double radius);
 
 private:
+    friend class Document;
     void RenderObject(const RenderContext& context) const override;
     void RenderAttrs(std::ostream& out) const override{
         PathProps<Circle>::RenderAttrs(out);
@@ -235,6 +287,7 @@ public:
     Polyline& AddPoint(Point point);
     
 private:
+    friend class Document;
     void RenderObject(const RenderContext& context) const override;
     void RenderAttrs(std::ostream& out) const override{
         PathProps<Polyline>::RenderAttrs(out);
@@ -252,6 +305,7 @@ public:
     Text& SetData(std::string data);
 
 private:
+    friend class Document;
     void RenderObject(const RenderContext& context) const override;
     void RenderAttrs(std::ostream& out) const override{
         PathProps<Text>::RenderAttrs(out);
@@ -264,14 +318,81 @@ private:
     std::string data_;
 };
 
+template <typename T>
+void ObjectContainer::Add(T&& obj) {
+    using Shape = std::decay_t<T>;
+    static_assert(std::is_base_of_v<Object, Shape>, "T must derive from Object");
+    if constexpr (std::is_same_v<Shape, Circle> || std::is_same_v<Shape, Polyline>
+                  || std::is_same_v<Shape, Text>) {
+        AddShape(static_cast<const Shape&>(obj));
+    } else {
+        AddPtr(std::make_unique<Shape>(std::forward<T>(obj)));
+    }
+}
+
+// Документ хранит фигуры не отдельными объектами, а списком команд отрисовки.
+// Координаты всех фигур лежат подряд в одном массиве, подписи — в одной строке,
+// а атрибуты оформления (стиль) хранятся по одному разу на каждый различный набор
+// и разделяются всеми фигурами, которые их используют.
+// Вывод собирается в буфер и пишется в поток крупными порциями, без сброса потока
 class Document : public ObjectContainer {
 public:
-    void Render(std::ostream& out) const;
-    void AddPtr(std::unique_ptr<Object>&& obj) override {
-        objects_.push_back(std::move(obj));
+    // compact == nullptr — обычный вывод
+    void Render(std::ostream& out, const CompactFormat* compact = nullptr) const;
+    void AddPtr(std::unique_ptr<Object>&& obj) override;
+
+    // Документ, собранный из нескольких частей (например, нарисованных параллельно),
+    // выводится так: RenderBegin, RenderContent каждой части по порядку, RenderEnd.
+    // Результат совпадает с Render одного документа со всеми элементами
+    static void RenderBegin(std::ostream& out);
+    void RenderContent(std::ostream& out, const CompactFormat* compact = nullptr) const;
+    static void RenderEnd(std::ostream& out);
+
+    // Число добавленных фигур
+    size_t GetSize() const {
+        return commands_.size();
     }
+    // Дописывает в out обычный вывод фигур с номерами [begin, end)
+    void AppendContent(std::string& out, size_t begin, size_t end) const;
+
+protected:
+    void AddShape(const Circle& circle) override;
+    void AddShape(const Polyline& polyline) override;
+    void AddShape(const Text& text) override;
 
 private:
+    enum class CommandKind : uint8_t {
+        CIRCLE,
+        POLYLINE,
+        TEXT,
+        OBJECT
+    };
+    struct Command {
+        CommandKind kind;
+        // Номер стиля в styles_, для OBJECT — номер объекта в objects_
+        uint32_t style;
+        // Начало координат фигуры в coords_
+        uint32_t coords;
+        // Для POLYLINE — число точек, для TEXT — длина подписи
+        uint32_t count;
+        // Для TEXT — начало подписи в text_
+        uint32_t text;
+    };
+
+    // Возвращает номер стиля с текстом style_scratch_, добавляя его при первой встрече
+    uint32_t InternStyle();
+    // Дописывают в buffer фигуру, кроме OBJECT, в обычном и компактном виде
+    void AppendCommand(std::string& buffer, const Command& command) const;
+    void AppendCompactCommand(std::string& buffer, const Command& command, const CompactFormat& compact) const;
+    // Блок <style> с классом для каждого стиля документа
+    void AppendStyleSheet(std::string& buffer, const CompactFormat& compact) const;
+
+    std::vector<Command> commands_;
+    std::vector<double> coords_;
+    std::string text_;
+    std::vector<const std::string*> styles_;
+    std::unordered_map<std::string, uint32_t> style_ids_;
+    std::string style_scratch_;
     std::vector<std::unique_ptr<Object>> objects_;
 };
 
@@ -0,0 +1,143 @@
+#!/bin/sh
+# Сквозная проверка резидентного режима: сервер на сокете, запросы через --client.
+#
+#   g++ -std=c++17 -O2 -pthread -o transport_catalogue *.cpp
+#   tests/server_test.sh ./transport_catalogue
+#
+# Ответ сервера на пакет сравнивается с выводом разового запуска на том же справочнике,
+# поэтому эталонных ответов в репозитории нет. Проверяется, что некорректный пакет
+# получает {"error_message": ...}, а следующий за ним пакет обрабатывается как обычно,
+# и что клиент, не закрывший запись, не задерживает остальных дольше тайм-аута.
+# Так же проверяется поток пакетов --serve из stdin и то, что карта, собранная из кеша
+# фрагментов после изменения справочника, совпадает с нарисованной с нуля.
+
+set -u
+
+if [ $# -ne 1 ]; then
+    echo "usage: $0 PATH_TO_BINARY" >&2
+    exit 2
+fi
+
+APP=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+DATA=$(cd "$(dirname "$0")/server" && pwd)
+WORK=$(mktemp -d)
+SOCKET=$WORK/catalogue.sock
+SERVER_PID=
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+FAILED=0
+
+fail() {
+    echo "FAIL: $1" >&2
+    FAILED=1
+}
+
+# Ответ должен совпасть с разовым запуском с точностью до завершающего перевода строки
+expect_same() {
+    if ! printf '%s\n' "$(cat "$2")" | cmp -s - "$3"; then
+        fail "$1: reply differs from one-shot output"
+        diff "$2" "$3" | head -20 >&2
+    fi
+}
+
+# Делит вывод --serve на ответы: PREFIX1.json, PREFIX2.json, ... Ответ кончается
+# строкой "]" без отступа или однострочным {"error_message": ...}
+split_replies() {
+    awk -v prefix="$2" '{ print > (prefix (n + 1) ".json") } $0 == "]" || /^\{"error_message"/ { n++ }' "$1"
+}
+
+expect_error() {
+    if ! grep -q '^{"error_message":' "$2"; then
+        fail "$1: expected an error reply, got: $(head -c 200 "$2")"
+    fi
+}
+
+"$APP" "$DATA/base.json" > "$WORK/expected.json" 2>/dev/null \
+    || { echo "one-shot run failed" >&2; exit 1; }
+
+# --- сокет ---
+
+"$APP" --socket="$SOCKET" "$DATA/base.json" 2>"$WORK/server.log" &
+SERVER_PID=$!
+i=0
+while [ ! -S "$SOCKET" ]; do
+    i=$((i + 1))
+    if [ $i -gt 100 ] || ! kill -0 "$SERVER_PID" 2>/dev/null; then
+        echo "server did not start:" >&2
+        cat "$WORK/server.log" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+send() {
+    "$APP" --client="$SOCKET" < "$DATA/$1" > "$WORK/$2" || fail "client exited with an error on $1"
+}
+
+send batch.json reply1.json
+expect_same "socket batch" "$WORK/expected.json" "$WORK/reply1.json"
+
+send malformed_json.json reply2.json
+expect_error "socket malformed JSON" "$WORK/reply2.json"
+
+send bad_request.json reply3.json
+expect_error "socket request without a name" "$WORK/reply3.json"
+
+# Сервер жив, и запросы из неудачных пакетов не попали в ответ
+send batch.json reply4.json
+expect_same "socket batch after errors" "$WORK/expected.json" "$WORK/reply4.json"
+
+# Клиент, который долго не закрывает запись, получает ошибку по тайм-ауту (10 с),
+# а пришедший следом клиент обслуживается не позже чем по истечении этого тайм-аута
+(sleep 12; cat "$DATA/batch.json") | "$APP" --client="$SOCKET" > "$WORK/stalled.json" &
+STALLED_PID=$!
+sleep 0.5
+send batch.json reply5.json
+expect_same "socket batch behind a stalled client" "$WORK/expected.json" "$WORK/reply5.json"
+wait "$STALLED_PID"
+if ! grep -q '^{"error_message":"Request timed out"}$' "$WORK/stalled.json"; then
+    fail "stalled client: expected a timeout error, got: $(head -c 200 "$WORK/stalled.json")"
+fi
+
+kill -0 "$SERVER_PID" 2>/dev/null || fail "server exited"
+
+# --- поток пакетов из stdin ---
+
+cat "$DATA/base.json" "$DATA/malformed_json.json" "$DATA/batch.json" \
+    | "$APP" --serve > "$WORK/stream.json" 2>/dev/null \
+    || fail "--serve exited with an error"
+split_replies "$WORK/stream.json" "$WORK/stream"
+expect_same "stream base batch" "$WORK/expected.json" "$WORK/stream1.json"
+expect_error "stream malformed JSON" "$WORK/stream2.json"
+expect_same "stream batch after error" "$WORK/expected.json" "$WORK/stream3.json"
+
+# --- карта из кеша фрагментов после изменения справочника ---
+
+# Карта после добавления маршрута, который встаёт первым по имени, и новой остановки
+# собирается из прежних фрагментов; она должна совпасть с картой, нарисованной с нуля.
+# Включено разрешение коллизий подписей: выбор подписи входит в ключ фрагмента
+"$APP" "$DATA/map_base.json" > "$WORK/map1_expected.json" 2>/dev/null \
+    || fail "one-shot map run failed"
+"$APP" "$DATA/map_full.json" > "$WORK/map2_expected.json" 2>/dev/null \
+    || fail "one-shot map run failed"
+for THREADS in 1 4; do
+    cat "$DATA/map_base.json" "$DATA/map_update.json" \
+        | "$APP" --serve --threads=$THREADS > "$WORK/maps.json" 2>/dev/null \
+        || fail "--serve --threads=$THREADS exited with an error"
+    split_replies "$WORK/maps.json" "$WORK/maps$THREADS-"
+    expect_same "map before update, threads=$THREADS" "$WORK/map1_expected.json" "$WORK/maps$THREADS-1.json"
+    expect_same "map after update, threads=$THREADS" "$WORK/map2_expected.json" "$WORK/maps$THREADS-2.json"
+done
+
+if [ $FAILED -ne 0 ]; then
+    exit 1
+fi
+echo "server_test: OK"
@@ -0,0 +1,96 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Пул и номер очереди текущего рабочего потока
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i] {
+            WorkerLoop(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(wait_mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Push(Task task) {
+    const size_t index = current_pool == this
+        ? current_index
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    // Счётчик увеличивается до публикации задачи, чтобы не уйти в минус
+    pending_.fetch_add(1);
+    {
+        std::lock_guard lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(wait_mutex_);
+    }
+    cv_.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t index, Task& task) {
+    TaskQueue& queue = *queues_[index];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::TrySteal(size_t index, Task& task) {
+    for (size_t shift = 1; shift < queues_.size(); ++shift) {
+        TaskQueue& queue = *queues_[(index + shift) % queues_.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        Task task;
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            pending_.fetch_sub(1);
+            task();
+            continue;
+        }
+        std::unique_lock lock(wait_mutex_);
+        cv_.wait(lock, [this] {
+            return stopping_ || pending_.load() > 0;
+        });
+        if (stopping_ && pending_.load() == 0) {
+            return;
+        }
+    }
+}
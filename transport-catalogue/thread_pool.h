@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Пул потоков фиксированного размера с перехватом задач (work stealing).
+// У каждого потока своя очередь: свои задачи он берёт с конца (LIFO),
+// а когда она пуста — забирает задачи из начала чужих очередей (FIFO).
+// Задачи, поставленные извне пула, раскладываются по очередям по кругу
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const {
+        return workers_.size();
+    }
+
+    template <typename Fn>
+    auto Submit(Fn&& fn) -> std::future<std::invoke_result_t<std::decay_t<Fn>>>;
+
+private:
+    using Task = std::function<void()>;
+
+    struct TaskQueue {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    void Push(Task task);
+    bool TryPop(size_t index, Task& task);
+    bool TrySteal(size_t index, Task& task);
+    void WorkerLoop(size_t index);
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> pending_{0};
+    std::mutex wait_mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+
+template <typename Fn>
+auto ThreadPool::Submit(Fn&& fn) -> std::future<std::invoke_result_t<std::decay_t<Fn>>> {
+    using Result = std::invoke_result_t<std::decay_t<Fn>>;
+    // std::function требует копируемости, поэтому packaged_task хранится в shared_ptr
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+    std::future<Result> result = task->get_future();
+    Push([task] {
+        (*task)();
+    });
+    return result;
+}
+
+// Дожидается всех задач, затем забирает результаты по порядку; исключение первой
+// упавшей задачи передаётся дальше только после завершения остальных. Нужна везде,
+// где задачи ссылаются на локальные данные вызывающего: ранний выход из цикла get()
+// разрушил бы эти данные, пока другие задачи ещё с ними работают
+template <typename T>
+void WaitAll(const std::vector<std::future<T>>& futures) {
+    for (const auto& future : futures) {
+        if (future.valid()) {
+            future.wait();
+        }
+    }
+}
+
+template <typename T>
+std::vector<T> GetAll(std::vector<std::future<T>>& futures) {
+    WaitAll(futures);
+    std::vector<T> results;
+    results.reserve(futures.size());
+    for (auto& future : futures) {
+        results.push_back(future.get());
+    }
+    return results;
+}
+
+inline void GetAll(std::vector<std::future<void>>& futures) {
+    WaitAll(futures);
+    for (auto& future : futures) {
+        future.get();
+    }
+}
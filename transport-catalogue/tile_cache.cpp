@@ -0,0 +1,122 @@
+#include "tile_cache.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <future>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+std::optional<std::string> TileCache::GetTile(TileId tile) {
+    renderer_.PrepareTiles();
+    if (!MapRenderer::IsValidTile(tile)) {
+        return std::nullopt;
+    }
+    if (root_.empty()) {
+        return RenderTile(tile);
+    }
+    const std::filesystem::path path = GetTilePath(tile);
+    if (std::ifstream file{path, std::ios::binary}) {
+        metrics::Registry::Instance().Increment("tiles_read");
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::string content = RenderTile(tile);
+    try {
+        WriteFile(path, content);
+    } catch (const std::exception& e) {
+        // Кеш — только ускорение: без записи на диск плитка нарисуется снова при следующем запросе
+        metrics::Registry::Instance().Increment("tile_write_errors");
+        std::cerr << "tile cache: "sv << e.what() << std::endl;
+    }
+    return content;
+}
+
+TileCache::GenerateStats TileCache::Generate(int max_zoom, ThreadPool* pool) {
+    static constexpr size_t TILES_PER_TASK = 16;
+
+    if (root_.empty()) {
+        throw std::logic_error("Tile cache directory is not set"s);
+    }
+    if (max_zoom < 0 || max_zoom > MAX_GENERATE_ZOOM) {
+        throw std::invalid_argument("Tile zoom must be in [0, "s + std::to_string(MAX_GENERATE_ZOOM) + "]"s);
+    }
+    renderer_.PrepareTiles();
+    std::vector<TileId> missing;
+    GenerateStats stats;
+    for (int z = 0; z <= max_zoom; ++z) {
+        for (int x = 0; x < (1 << z); ++x) {
+            for (int y = 0; y < (1 << z); ++y) {
+                if (std::filesystem::exists(GetTilePath({z, x, y}))) {
+                    ++stats.cached;
+                } else {
+                    missing.push_back({z, x, y});
+                }
+            }
+        }
+    }
+
+    const auto render_range = [this, &missing](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            WriteFile(GetTilePath(missing[i]), RenderTile(missing[i]));
+        }
+    };
+    if (pool == nullptr) {
+        render_range(0, missing.size());
+    } else {
+        // Задачи ссылаются на missing и render_range: при ошибке дожидаемся всех
+        std::vector<std::future<void>> tasks;
+        try {
+            for (size_t begin = 0; begin < missing.size(); begin += TILES_PER_TASK) {
+                tasks.push_back(pool->Submit([&render_range, begin, end = std::min(missing.size(), begin + TILES_PER_TASK)] {
+                    render_range(begin, end);
+                }));
+            }
+        } catch (...) {
+            WaitAll(tasks);
+            throw;
+        }
+        GetAll(tasks);
+    }
+    stats.rendered = missing.size();
+    return stats;
+}
+
+std::filesystem::path TileCache::GetTilePath(TileId tile) const {
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(renderer_.GetContentHash()));
+    return root_ / hash / std::to_string(tile.z) / std::to_string(tile.x) / (std::to_string(tile.y) + ".svg"s);
+}
+
+std::string TileCache::RenderTile(TileId tile) const {
+    MEASURE_PHASE("render");
+    metrics::Registry::Instance().Increment("tiles_rendered");
+    std::ostringstream out;
+    renderer_.DrawTile(out, tile);
+    return out.str();
+}
+
+void TileCache::WriteFile(const std::filesystem::path& path, const std::string& content) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ostringstream suffix;
+    suffix << ".tmp"sv << std::this_thread::get_id();
+    std::filesystem::path temp_path = path;
+    temp_path += suffix.str();
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!file) {
+            file.close();
+            std::error_code ignored;
+            std::filesystem::remove(temp_path, ignored);
+            throw std::runtime_error("Can't write tile "s + temp_path.string());
+        }
+    }
+    std::filesystem::rename(temp_path, path);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "map_renderer.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+class ThreadPool;
+
+// Дисковый кеш плиток карты. Плитки лежат в root/<хеш содержимого>/z/x/y.svg,
+// поэтому после изменения справочника или настроек кеш автоматически
+// становится другим каталогом, а старые плитки никогда не отдаются.
+// Без каталога (root пуст) плитки рисуются при каждом запросе
+class TileCache {
+public:
+    TileCache(MapRenderer& renderer, std::filesystem::path root)
+        : renderer_(renderer), root_(std::move(root)) {}
+
+    void SetDirectory(std::filesystem::path root) {
+        root_ = std::move(root);
+    }
+
+    // SVG плитки: из файла, а если его ещё нет — отрисованный и сохранённый.
+    // Если сохранить не удалось, плитка всё равно возвращается.
+    // nullopt, если такой плитки нет
+    std::optional<std::string> GetTile(TileId tile);
+
+    // Уровни 0..10 — около 1.4 млн плиток; больше заранее рисовать бессмысленно,
+    // такие плитки рисуются по запросу
+    static constexpr int MAX_GENERATE_ZOOM = 10;
+
+    struct GenerateStats {
+        size_t rendered = 0;
+        size_t cached = 0;
+    };
+    // Отрисовывает все плитки уровней 0..max_zoom, которых ещё нет в кеше.
+    // С пулом плитки рисуются и записываются параллельно.
+    // invalid_argument, если max_zoom вне [0, MAX_GENERATE_ZOOM]; ошибки записи передаются дальше
+    GenerateStats Generate(int max_zoom, ThreadPool* pool);
+
+private:
+    std::filesystem::path GetTilePath(TileId tile) const;
+    std::string RenderTile(TileId tile) const;
+    // Пишет во временный файл и переименовывает, чтобы читатель не увидел плитку наполовину
+    static void WriteFile(const std::filesystem::path& path, const std::string& content);
+
+    MapRenderer& renderer_;
+    std::filesystem::path root_;
+};
@@ -0,0 +1,133 @@
+#include "trace.h"
+#include "json_writer.h"
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std::literals;
+
+namespace trace {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+struct Event {
+    std::string_view name;
+    int64_t begin_ns;
+    int64_t duration_ns;
+    int64_t id;
+};
+
+// deque не перемещает уже записанные события при росте
+struct ThreadBuffer {
+    int tid;
+    std::deque<Event> events;
+};
+
+struct Buffers {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> list;
+    Clock::time_point origin = Clock::now();
+};
+
+Buffers& GetBuffers() {
+    static Buffers buffers;
+    return buffers;
+}
+
+// Блокировка берётся один раз на поток — при первой записи
+ThreadBuffer& GetThreadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        Buffers& buffers = GetBuffers();
+        std::lock_guard lock(buffers.mutex);
+        buffers.list.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.list.back().get();
+        buffer->tid = static_cast<int>(buffers.list.size());
+    }
+    return *buffer;
+}
+
+int64_t ToNs(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+double ToUs(int64_t ns) {
+    return static_cast<double>(ns) / 1e3;
+}
+
+} // namespace
+
+void Start() {
+    GetBuffers().origin = Clock::now();
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+void Record(std::string_view name, Clock::time_point begin, Clock::time_point end, int64_t id) {
+    const Clock::time_point origin = GetBuffers().origin;
+    GetThreadBuffer().events.push_back({name, ToNs(begin - origin), ToNs(end - begin), id});
+}
+
+void WriteFile(const std::string& path) {
+    detail::enabled.store(false, std::memory_order_relaxed);
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "cannot write trace to "sv << path << std::endl;
+        return;
+    }
+
+    Buffers& buffers = GetBuffers();
+    std::lock_guard lock(buffers.mutex);
+    json::Writer writer(out, json::Layout::COMPACT);
+    writer.StartDict()
+    .Key("displayTimeUnit"sv).Value("ms"sv)
+    .Key("traceEvents"sv).StartArray();
+    for (const auto& buffer : buffers.list) {
+        writer.StartDict()
+        .Key("args"sv).StartDict().Key("name"sv).Value("thread "s + std::to_string(buffer->tid)).EndDict()
+        .Key("name"sv).Value("thread_name"sv)
+        .Key("ph"sv).Value("M"sv)
+        .Key("pid"sv).Value(1)
+        .Key("tid"sv).Value(buffer->tid)
+        .EndDict();
+        for (const Event& event : buffer->events) {
+            writer.StartDict();
+            if (event.id != NO_ID) {
+                writer.Key("args"sv).StartDict().Key("id"sv).Value(static_cast<double>(event.id)).EndDict();
+            }
+            writer.Key("dur"sv).Value(ToUs(event.duration_ns))
+            .Key("name"sv).Value(event.name)
+            .Key("ph"sv).Value("X"sv)
+            .Key("pid"sv).Value(1)
+            .Key("tid"sv).Value(buffer->tid)
+            .Key("ts"sv).Value(ToUs(event.begin_ns))
+            .EndDict();
+        }
+    }
+    writer.EndArray()
+    .EndDict();
+    writer.Flush();
+    out << '\n';
+}
+
+Session::Session(std::string path)
+    : path_(std::move(path)) {
+    if (!path_.empty()) {
+        Start();
+    }
+}
+
+Session::~Session() {
+    if (!path_.empty()) {
+        WriteFile(path_);
+    }
+}
+
+} // namespace trace
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Запись интервалов в формате Chrome trace (chrome://tracing, ui.perfetto.dev).
+// По умолчанию выключена: проверка IsEnabled — одно чтение атомарной переменной.
+// Каждый поток пишет в свой буфер без блокировок; буферы живут до конца процесса
+namespace trace {
+
+using Clock = std::chrono::steady_clock;
+
+// Событие без номера запроса
+inline constexpr int64_t NO_ID = -1;
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool IsEnabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Включает запись до запуска рабочих потоков; время в файле отсчитывается от этого вызова
+void Start();
+// Интервал [begin, end] в буфере текущего потока. name не копируется,
+// поэтому должен жить до WriteFile — обычно это строковый литерал
+void Record(std::string_view name, Clock::time_point begin, Clock::time_point end, int64_t id = NO_ID);
+// Выключает запись и сохраняет события всех потоков.
+// Вызывается, когда другие потоки уже ничего не записывают
+void WriteFile(const std::string& path);
+
+// Интервал от создания до разрушения объекта, если запись включена
+class Scope {
+public:
+    explicit Scope(std::string_view name)
+        : name_(name), enabled_(IsEnabled()) {
+        if (enabled_) {
+            start_ = Clock::now();
+        }
+    }
+    ~Scope() {
+        if (enabled_) {
+            Record(name_, start_, Clock::now());
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    std::string_view name_;
+    bool enabled_;
+    Clock::time_point start_;
+};
+
+// Запись на время жизни объекта: с пустым путём ничего не делает
+class Session {
+public:
+    explicit Session(std::string path);
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+private:
+    std::string path_;
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_INTERNAL(X, Y) X ## Y
+#define TRACE_CONCAT(X, Y) TRACE_CONCAT_INTERNAL(X, Y)
+#define TRACE_SCOPE(x) trace::Scope TRACE_CONCAT(traceScope, __LINE__)(x)
@@ -7,13 +7,14 @@
 #include <cassert>
 #include <set>
 #include <iostream>
-void TransportCatalogue::AddStop(const std::string& name, double latitude, double longitude) {
-    stops_.emplace_back(Stop{name, latitude, longitude});
+void TransportCatalogue::AddStop(std::string_view name, double latitude, double longitude) {
+    stops_.emplace_back(Stop{std::string(name), latitude, longitude, stops_.size()});
     stopname_to_stop_[stops_.back().name] = &stops_.back();
+    ++version_;
 }
 
-void TransportCatalogue::AddDistance(const std::string& from_stop_name, const std::string& to_stop_name, int distance) {
-    temp_distances_.emplace_back(from_stop_name, to_stop_name, distance);
+void TransportCatalogue::AddDistance(std::string_view from_stop_name, std::string_view to_stop_name, int distance) {
+    temp_distances_.emplace_back(std::string(from_stop_name), std::string(to_stop_name), distance);
 }
 void TransportCatalogue::SetDistance() {
     for (const auto& [from_name, to_name, distance] : temp_distances_) {
@@ -31,69 +32,68 @@ void TransportCatalogue::SetDistance() {
     temp_distances_.clear();
 }
 
-void TransportCatalogue::AddBus(const std::string& name, const std::vector<std::string>& stop_names, bool is_roundtrip) {
-    Bus bus{name, {}, is_roundtrip};
-
-    
-    if (is_roundtrip) {
-        for (const auto& stop_name : stop_names) {
-            const Stop* stop = FindStop(stop_name);
-            if (stop) {
-                bus.stops.push_back(stop);
-                bus_to_stops_[name].insert(stop->name);
-                stop_to_buses_[stop->name].insert(name);
-            }
-        }
-    } 
-    
-    else {
-        for (const auto& stop_name : stop_names) {
-            const Stop* stop = FindStop(stop_name);
-            if (stop) {
-                bus.stops.push_back(stop);
-                bus_to_stops_[name].insert(stop->name);
-                stop_to_buses_[stop->name].insert(name);
-            }
+void TransportCatalogue::AddBus(std::string_view name, const std::vector<std::string_view>& stop_names, bool is_roundtrip) {
+    // Ключи индексов ссылаются на имя, хранящееся в самом справочнике,
+    // а не на строку вызывающего кода
+    Bus& bus = buses_.emplace_back(Bus{std::string(name), {}, is_roundtrip});
+    bus.velocity = velocity_;
+    bus.wait_time = wait_time_;
+    const std::string_view bus_name = bus.name;
+
+    auto add_stop = [&](std::string_view stop_name) {
+        const Stop* stop = FindStop(stop_name);
+        if (stop) {
+            bus.stops.push_back(stop);
+            bus_to_stops_[bus.name].insert(stop->name);
+            stop_to_buses_[stop->name].insert(bus_name);
         }
-        
+    };
+
+    for (const auto& stop_name : stop_names) {
+        add_stop(stop_name);
+    }
+    if (!is_roundtrip) {
         for (size_t i = stop_names.size()-1; i > 0; --i) {
-            const Stop* stop = FindStop(stop_names[i - 1]);
-            if (stop) {
-                bus.stops.push_back(stop);
-                bus_to_stops_[name].insert(stop->name);
-                stop_to_buses_[stop->name].insert(name);
-            }
+            add_stop(stop_names[i - 1]);
         }
     }
 
-    buses_.push_back(bus);
-    busname_to_bus_[name] = &buses_.back();
+    busname_to_bus_[bus_name] = &bus;
+    ++version_;
 }
 void TransportCatalogue::SetVelocityAndWaitTime(double velocity,double wait_time){
+    // Запоминаются и для маршрутов, которые будут добавлены позже
+    velocity_ = velocity * 1000 / 60;
+    wait_time_ = wait_time;
     for(Bus& bus: buses_){
-        bus.velocity = velocity * 1000 / 60;
-        bus.wait_time = wait_time;
+        bus.velocity = velocity_;
+        bus.wait_time = wait_time_;
     }
 }
 
 double TransportCatalogue::GetWaitTime()const{
-    return buses_[0].wait_time;
+    return wait_time_;
 }
 const std::set<std::string_view>* TransportCatalogue::GetBusesForStop(const std::string& stop_name) const {
     auto it = stop_to_buses_.find(stop_name);
     return it != stop_to_buses_.end() ? &it->second : nullptr;
 }
 
+const std::set<std::string_view>* TransportCatalogue::GetBusesForStop(const Stop& stop) const {
+    auto it = stop_to_buses_.find(stop.name);
+    return it != stop_to_buses_.end() ? &it->second : nullptr;
+}
+
 
 
 
 
-const Bus* TransportCatalogue::FindBus(const std::string& name) const {
+const Bus* TransportCatalogue::FindBus(std::string_view name) const {
     auto it = busname_to_bus_.find(name);
     return it != busname_to_bus_.end() ? it->second : nullptr;
 }
 
-const Stop* TransportCatalogue::FindStop(const std::string& name) const {
+const Stop* TransportCatalogue::FindStop(std::string_view name) const {
     auto it = stopname_to_stop_.find(name);
     return it != stopname_to_stop_.end() ? it->second : nullptr;
 }
@@ -116,7 +116,11 @@ std::optional<BusInfo> TransportCatalogue::GetBusInfo(const std::string& bus_nam
     if (!bus) {
         return std::nullopt;  
     }
+    return GetBusInfo(*bus);
+}
 
+BusInfo TransportCatalogue::GetBusInfo(const Bus& bus_ref) const {
+    const Bus* bus = &bus_ref;
     int stop_count = bus->stops.size();
     std::unordered_set<const Stop*> unique_stops(bus->stops.begin(), bus->stops.end());
     int unique_stop_count = unique_stops.size();
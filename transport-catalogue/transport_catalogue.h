@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <optional>
+#include <cstdint>
+#include <string_view>
 
 
 struct PairHash {
@@ -18,19 +20,21 @@ struct PairHash {
 };
 class TransportCatalogue {
 public:
-    void AddStop(const std::string& name, double latitude, double longitude);
-    void AddBus(const std::string& name, const std::vector<std::string>& stop_names, bool is_roundtrip);
+    void AddStop(std::string_view name, double latitude, double longitude);
+    void AddBus(std::string_view name, const std::vector<std::string_view>& stop_names, bool is_roundtrip);
     void SetVelocityAndWaitTime(double velocity, double wait_time);
     size_t GetStopsCount() const;
     
     double GetWaitTime()const;
-    void AddDistance(const std::string& from_stop_name, const std::string& to_stop_name, int distance);
+    void AddDistance(std::string_view from_stop_name, std::string_view to_stop_name, int distance);
     void SetDistance();
-    const Bus* FindBus(const std::string& name) const;
-    const Stop* FindStop(const std::string& name) const;
+    const Bus* FindBus(std::string_view name) const;
+    const Stop* FindStop(std::string_view name) const;
     std::optional<double> GetDistance(const Stop* from_stop, const Stop* to_stop) const;
     std::optional<BusInfo> GetBusInfo(const std::string& bus_name) const;
+    BusInfo GetBusInfo(const Bus& bus) const;
     const std::set<std::string_view>* GetBusesForStop(const std::string& stop_name) const;
+    const std::set<std::string_view>* GetBusesForStop(const Stop& stop) const;
     const std::deque<Bus> GetSortedRoutes() const;
     const std::deque<Bus>& GetRoutes() const{
         return buses_;
@@ -40,7 +44,11 @@ public:
     }
     const std::vector<const Stop*> GetSortedStops() const;
     bool StopIsUseless(const std::string& name)const;
-    
+    // Меняется при каждом добавлении остановки или маршрута;
+    // по нему производные данные (например, готовая карта) понимают, что устарели
+    uint64_t GetVersion() const{
+        return version_;
+    }
     
 private:
     std::deque<Stop> stops_;
@@ -54,4 +62,7 @@ private:
     std::unordered_map<std::string, std::unordered_set<std::string_view>> bus_to_stops_;
     std::unordered_map<std::pair<const Stop*, const Stop*>, double, PairHash> distance_map_;
     std::vector<std::tuple<std::string, std::string, int>> temp_distances_;
+    double velocity_ = .0;
+    double wait_time_ = .0;
+    uint64_t version_ = 0;
 };
\ No newline at end of file
@@ -2,19 +2,20 @@
 
 #include "transport_catalogue.h"
 #include "router.h"
-#include "json.h"
 #include "graph.h"
 #include <map>
+#include <memory>
+#include <optional>
 
 
 
 class TransportRouter{
 public:
-    using builder = std::optional<json::Node>;
+    using RouteInfo = graph::Router<double>::RouteInfo;
     TransportRouter(const TransportCatalogue& catalogue);
     
     const graph::DirectedWeightedGraph<double>& GetGraph() const;
-    builder BuildRoute(const std::string& from, const std::string to, int request_id)const;
+    std::optional<RouteInfo> BuildRoute(const std::string& from, const std::string& to)const;
     
 private:
     void BuildGraph(const TransportCatalogue& catalogue);
@@ -22,7 +23,8 @@ private:
     
     std::map<std::string, graph::VertexId> stop_ids_;
     std::vector<std::string> stop_names_;
-    graph::Router<double>* router_ = nullptr;
     graph::DirectedWeightedGraph<double> graph_;
+    // Ссылается на graph_, поэтому объявлен после него и разрушается первым
+    std::unique_ptr<graph::Router<double>> router_;
     
 };
\ No newline at end of file